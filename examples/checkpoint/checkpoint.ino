@@ -0,0 +1,84 @@
+/*
+ * This file is part of the N2CMU Arduino library (https://github.com/nthnn/n2cmu-arduino).
+ * Copyright (c) 2024 Nathanne Isip.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <n2cmu.h>
+#include <n2cmu_checkpoint.h>
+
+void setup() {
+    // Initialize serial communication
+    Serial.begin(9600);
+    while(!Serial);
+
+    // Initialize the N2Coprocessor instance
+    N2Coprocessor coprocessor;
+    if(!coprocessor.begin() || !coprocessor.cpuReset()) {
+        Serial.println(F("Something went wrong. Halting..."));
+        while(true);
+    }
+
+    // Restore the model saved before the last power cut, if any,
+    // from a region sized for two checkpoints of the 2-2-1 network
+    N2Checkpoint checkpoint(
+        coprocessor,
+        0,
+        N2Checkpoint::getRequiredSize(2, 2, 1)
+    );
+    float dataset[][2] = {{0, 0}, {0, 1}, {1, 0}, {1, 1}};
+    float output[][1] = {{1}, {1}, {1}, {0}};
+
+    if(checkpoint.begin())
+        Serial.println(F("Model restored from EEPROM."));
+    else {
+        Serial.println(F("No checkpoint found, training..."));
+        coprocessor.createNetwork(2, 2, 1);
+        coprocessor.setEpochCount(4000);
+
+        if(!coprocessor.train((float*) dataset, (float*) output, 4, 1.0f)) {
+            Serial.println(F("Something went wrong. Halting..."));
+            while(true);
+        }
+    }
+
+    // Fine-tune a little, then checkpoint only what changed
+    coprocessor.setEpochCount(100);
+    coprocessor.train((float*) dataset, (float*) output, 4, 1.0f);
+
+    if(checkpoint.save()) {
+        Serial.print(F("Checkpoint saved, slots written: "));
+        Serial.println(checkpoint.getLastWriteCount());
+    }
+    else Serial.println(F("Checkpoint failed."));
+
+    // Perform inferences
+    Serial.println(F("Attempting inferences..."));
+    for(uint8_t i = 0; i < 4; i++) {
+        float result[1];
+        if(coprocessor.infer(dataset[i], result)) {
+            Serial.print(F("\t["));
+            Serial.print(dataset[i][0]);
+            Serial.print(F(", "));
+            Serial.print(dataset[i][1]);
+            Serial.print(F("]: "));
+            Serial.println(result[0]);
+        }
+        else Serial.println(F("Inference attempt failed."));
+    }
+}
+
+void loop() {
+    delay(1000);
+}
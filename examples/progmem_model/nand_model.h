@@ -0,0 +1,28 @@
+// Generated by n2cmu_model2header.py from nand.json. Do not edit.
+#ifndef NAND_MODEL_H
+#define NAND_MODEL_H
+
+#include <n2cmu.h>
+
+static const float nand_model_hidden_weights[] PROGMEM = {
+    -4.0134902f, -2.25856805f, -4.23175335f, -1.87480175f
+};
+
+static const float nand_model_output_weights[] PROGMEM = {
+    9.01012325f, 3.64280272f
+};
+
+static const float nand_model_hidden_bias[] PROGMEM = {
+    5.66827011f, 2.18228126f
+};
+
+static const float nand_model_output_bias[] PROGMEM = {
+    -4.93146467f
+};
+
+static const N2ProgmemModel nand_model PROGMEM = {
+    2, 2, 1, 4000,
+    {nand_model_hidden_weights, nand_model_output_weights, nand_model_hidden_bias, nand_model_output_bias}
+};
+
+#endif
@@ -0,0 +1,63 @@
+/*
+ * This file is part of the N2CMU Arduino library (https://github.com/nthnn/n2cmu-arduino).
+ * Copyright (c) 2024 Nathanne Isip.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <n2cmu.h>
+
+// Pretrained NAND model, generated with:
+//   extras/tools/n2cmu_model2header.py nand.json nand_model > nand_model.h
+#include "nand_model.h"
+
+void setup() {
+    // Initialize serial communication
+    Serial.begin(9600);
+    while(!Serial);
+
+    // Initialize the N2Coprocessor instance
+    N2Coprocessor coprocessor;
+    if(!coprocessor.begin() || !coprocessor.cpuReset()) {
+        Serial.println(F("Something went wrong. Halting..."));
+        while(true);
+    }
+
+    // Stream the pretrained model from flash, no training needed
+    Serial.println(F("Loading model from flash..."));
+    if(!coprocessor.loadFromProgmem(&nand_model)) {
+        Serial.println(F("Something went wrong. Halting..."));
+        while(true);
+    }
+
+    // Perform inferences
+    Serial.println(F("Attempting inferences..."));
+    float dataset[][2] = {{0, 0}, {0, 1}, {1, 0}, {1, 1}};
+
+    for(uint8_t i = 0; i < 4; i++) {
+        float output[1];
+        if(coprocessor.infer(dataset[i], output)) {
+            Serial.print(F("\t["));
+            Serial.print(dataset[i][0]);
+            Serial.print(F(", "));
+            Serial.print(dataset[i][1]);
+            Serial.print(F("]: "));
+            Serial.println(output[0]);
+        }
+        else Serial.println(F("Inference attempt failed."));
+    }
+}
+
+void loop() {
+    delay(1000);
+}
@@ -0,0 +1,72 @@
+/*
+ * This file is part of the N2CMU Arduino library (https://github.com/nthnn/n2cmu-arduino).
+ * Copyright (c) 2024 Nathanne Isip.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <n2cmu.h>
+#include <n2cmu_shared.h>
+
+#ifndef N2CMU_HAS_THREADS
+#error "This example requires a board with C++ thread support, such as the ESP32."
+#endif
+
+N2Coprocessor coprocessor;
+N2SharedCoprocessor shared(coprocessor);
+
+// Each task runs inferences through the shared front end
+void inferenceTask(void* parameter) {
+    float input[2] = {(float) (uint32_t) parameter, 1};
+
+    while(true) {
+        float output[1];
+
+        if(shared.infer(input, output).get()) {
+            Serial.print(F("Task "));
+            Serial.print((uint32_t) parameter);
+            Serial.print(F(": "));
+            Serial.println(output[0]);
+        }
+
+        vTaskDelay(pdMS_TO_TICKS(500));
+    }
+}
+
+void setup() {
+    Serial.begin(9600);
+    while(!Serial);
+
+    if(!coprocessor.begin() || !coprocessor.cpuReset()) {
+        Serial.println(F("Something went wrong. Halting..."));
+        while(true);
+    }
+
+    // Train a NAND network before sharing the co-processor
+    coprocessor.createNetwork(2, 2, 1);
+    coprocessor.setEpochCount(4000);
+
+    float dataset[][2] = {{0, 0}, {0, 1}, {1, 0}, {1, 1}};
+    float output[][1] = {{1}, {1}, {1}, {0}};
+    coprocessor.train((float*) dataset, (float*) output, 4, 1.0f);
+
+    // From here on, only the shared front end touches the co-processor
+    shared.start();
+
+    xTaskCreate(inferenceTask, "infer0", 4096, (void*) 0, 1, NULL);
+    xTaskCreate(inferenceTask, "infer1", 4096, (void*) 1, 1, NULL);
+}
+
+void loop() {
+    delay(1000);
+}
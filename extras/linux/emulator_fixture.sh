@@ -0,0 +1,59 @@
+#!/bin/sh
+#
+# This file is part of the N2CMU Arduino library (https://github.com/nthnn/n2cmu-arduino).
+# Copyright (c) 2024 Nathanne Isip.
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, version 3.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+# Start and stop an n2cmu_emulator for the CTest fixtures:
+#
+#     emulator_fixture.sh start <emulator> <link> [emulator options]
+#     emulator_fixture.sh stop <link>
+#
+# The emulator runs in the background, detached from the test's output,
+# and its process ID is kept next to the link.
+
+action=$1
+shift
+
+case "$action" in
+    start)
+        emulator=$1
+        link=$2
+        shift 2
+
+        rm -f "$link"
+        "$emulator" "$@" "$link" > /dev/null 2>&1 &
+        echo $! > "$link.pid"
+
+        # Wait for the emulator to create the link
+        for i in 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19 20; do
+            [ -e "$link" ] && exit 0
+            sleep 0.1
+        done
+
+        echo "n2cmu_emulator did not create $link" >&2
+        exit 1
+        ;;
+
+    stop)
+        link=$1
+
+        [ -f "$link.pid" ] && kill "$(cat "$link.pid")" 2> /dev/null
+        rm -f "$link.pid"
+        exit 0
+        ;;
+esac
+
+echo "usage: $0 start <emulator> <link> [options] | stop <link>" >&2
+exit 2
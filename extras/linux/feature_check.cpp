@@ -0,0 +1,293 @@
+/*
+ * This file is part of the N2CMU Arduino library (https://github.com/nthnn/n2cmu-arduino).
+ * Copyright (c) 2024 Nathanne Isip.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Checks the library features end to end against the device emulator:
+//
+//     ./n2cmu_emulator /tmp/n2cmu &
+//     ./n2cmu_feature_check /tmp/n2cmu
+//
+// The checkpoint checks use the EEPROM file in the working directory.
+
+#include <math.h>
+#include <stdio.h>
+
+#include <n2cmu.h>
+#include <n2cmu_checkpoint.h>
+
+static float dataset[][2] = {{0, 0}, {0, 1}, {1, 0}, {1, 1}};
+static float nand[][1] = {{1}, {1}, {1}, {0}};
+static float conjunction[][1] = {{0}, {0}, {0}, {1}};
+
+static int failures = 0;
+
+// Report one check and count it if it failed
+static void check(bool condition, const char *description) {
+    printf("\t%s: %s\n", condition ? "ok" : "FAILED", description);
+    if(!condition)
+        failures++;
+}
+
+// Run the truth table through the network
+static bool inferAll(N2Coprocessor &coprocessor, float *outputs) {
+    for(uint8_t i = 0; i < 4; i++)
+        if(!coprocessor.infer(dataset[i], outputs + i))
+            return false;
+
+    return true;
+}
+
+// Check whether the outputs classify the truth table as NAND
+static bool isNand(const float *outputs) {
+    for(uint8_t i = 0; i < 4; i++)
+        if((outputs[i] > 0.5f) != (nand[i][0] > 0.5f))
+            return false;
+
+    return true;
+}
+
+// Train a fresh NAND network with plain SGD
+static bool trainNand(N2Coprocessor &coprocessor, uint8_t hiddenCount) {
+    coprocessor.createNetwork(2, hiddenCount, 1);
+    coprocessor.setEpochCount(4000);
+
+    return coprocessor.train((float*) dataset, (float*) nand, 4, 1.0f);
+}
+
+static void checkOptimizedTraining(N2Coprocessor &coprocessor) {
+    printf("Training with momentum and mini-batches...\n");
+
+    N2TrainingConfig config;
+    config.learningRate = 1.0f;
+    config.momentum = 0.9f;
+    config.schedule = N2CMU_LR_STEP;
+    config.decayRate = 0.5f;
+    config.decayStep = 500;
+    config.batchSize = 2;
+
+    coprocessor.createNetwork(2, 2, 1);
+    coprocessor.setEpochCount(1500);
+    check(coprocessor.train((float*) dataset, (float*) nand, 4, config), "train() accepts the configuration");
+
+    float outputs[4];
+    check(inferAll(coprocessor, outputs) && isNand(outputs), "the network learns NAND");
+}
+
+static void checkEvaluation(N2Coprocessor &coprocessor) {
+    printf("Evaluating on the device...\n");
+
+    float outputs[4];
+    if(!inferAll(coprocessor, outputs)) {
+        check(false, "reference inferences");
+        return;
+    }
+
+    // Against AND, the NAND outputs are all wrong
+    float nandError = 0.0f, conjunctionError = 0.0f;
+    for(uint8_t i = 0; i < 4; i++) {
+        nandError += (outputs[i] - nand[i][0]) * (outputs[i] - nand[i][0]);
+        conjunctionError += (outputs[i] - conjunction[i][0]) * (outputs[i] - conjunction[i][0]);
+    }
+
+    N2Evaluation result;
+    check(coprocessor.evaluate((float*) dataset, (float*) nand, 4, &result, true), "evaluate() against NAND");
+    check(fabsf(result.meanSquaredError - nandError / 4) < 1e-5f, "mean squared error matches the inferences");
+    check(result.accuracy == 1.0f, "accuracy is 1");
+    check(result.truePositives == 3 && result.falsePositives == 0 &&
+        result.trueNegatives == 1 && result.falseNegatives == 0, "confusion is 3 TP, 1 TN");
+
+    check(coprocessor.evaluate((float*) dataset, (float*) conjunction, 4, &result, true), "evaluate() against AND");
+    check(fabsf(result.meanSquaredError - conjunctionError / 4) < 1e-5f, "mean squared error matches the inferences");
+    check(result.accuracy == 0.0f, "accuracy is 0");
+    check(result.truePositives == 0 && result.falsePositives == 3 &&
+        result.trueNegatives == 0 && result.falseNegatives == 1, "confusion is 3 FP, 1 FN");
+}
+
+static void checkDevicePerf(N2Coprocessor &coprocessor) {
+    printf("Reading the performance counters...\n");
+
+    N2DevicePerf perf;
+    check(coprocessor.getDevicePerf(&perf), "getDevicePerf()");
+    check(perf.trainMicros > 0 && perf.epochMicros <= perf.trainMicros, "an epoch is part of the training run");
+    check(perf.rxHighWater > 0, "the receive buffer was used");
+    check(perf.rxOverruns == 0, "no received bytes were dropped");
+}
+
+static void checkSweep(N2Coprocessor &coprocessor) {
+    printf("Running a hyperparameter sweep...\n");
+
+    const uint8_t hiddenCounts[] = {1, 3};
+    const float learningRates[] = {1.0f};
+    const uint16_t epochCounts[] = {5, 4000};
+    N2SweepConfig configs[4];
+
+    uint8_t count = N2Coprocessor::buildSweepGrid(hiddenCounts, 2, learningRates, 1, epochCounts, 2, configs);
+    check(count == 4, "buildSweepGrid() builds every combination");
+
+    uint8_t manyHidden[16];
+    float manyRates[16];
+    for(uint8_t i = 0; i < 16; i++) {
+        manyHidden[i] = i + 1;
+        manyRates[i] = 0.1f * (i + 1);
+    }
+    check(N2Coprocessor::buildSweepGrid(manyHidden, 16, manyRates, 16, epochCounts, 1, NULL) == 0,
+        "buildSweepGrid() refuses 256 combinations");
+
+    // The truth table twice, the second copy for validation
+    float data[8][2], output[8][1];
+    for(uint8_t i = 0; i < 8; i++) {
+        data[i][0] = dataset[i % 4][0];
+        data[i][1] = dataset[i % 4][1];
+        output[i][0] = nand[i % 4][0];
+    }
+
+    float scores[4];
+    uint8_t best = 0xff;
+    check(coprocessor.sweep((float*) data, (float*) output, 8, 4, configs, count, scores, &best), "sweep()");
+
+    bool lowest = best < count;
+    for(uint8_t i = 0; i < count && lowest; i++)
+        lowest = scores[best] <= scores[i];
+
+    check(lowest, "the best candidate has the lowest score");
+    check(best < count && configs[best].epochCount == 4000, "the best candidate trained for long");
+    check(best < count && coprocessor.getInputCount() == 2 &&
+        coprocessor.getHiddenCount() == configs[best].hiddenCount &&
+        coprocessor.getOutputCount() == 1, "the best topology is active");
+
+    float outputs[4];
+    check(inferAll(coprocessor, outputs) && isNand(outputs), "the best model is active");
+}
+
+// Record the training progress frames
+typedef struct ProgressLog {
+    uint16_t frames;
+    uint16_t lastEpoch;
+    float lastLoss;
+    float previousLoss;
+} ProgressLog;
+
+static bool logProgress(uint16_t epoch, float loss, void *context) {
+    ProgressLog *log = (ProgressLog*) context;
+
+    log->frames++;
+    log->lastEpoch = epoch;
+    log->previousLoss = log->lastLoss;
+    log->lastLoss = loss;
+
+    return true;
+}
+
+static void checkEarlyStopping(N2Coprocessor &coprocessor) {
+    printf("Training with early stopping...\n");
+
+    ProgressLog log = {0, 0, 0.0f, 0.0f};
+    coprocessor.setTrainingProgress(10, logProgress, &log);
+    coprocessor.setEarlyStopping(0.02f);
+
+    bool trained = trainNand(coprocessor, 2);
+    coprocessor.setTrainingProgress(0);
+    coprocessor.setEarlyStopping(0.0f);
+
+    check(trained, "train() succeeds when stopped early");
+    check(log.frames > 1, "progress frames were received");
+    check(log.lastEpoch < 4000, "training stopped before the last epoch");
+    check(log.lastLoss < 0.02f && log.previousLoss >= 0.02f, "training stopped at the first loss below the threshold");
+}
+
+static void checkModelUpdate(N2Coprocessor &coprocessor) {
+    printf("Updating the model in the staging slot...\n");
+
+    float before[4], during[4], after[4];
+    float bias[1] = {-50.0f};
+
+    bool read = inferAll(coprocessor, before);
+    check(coprocessor.beginModelUpdate() && coprocessor.isUpdatingModel(), "beginModelUpdate()");
+    check(coprocessor.setParameter(N2CMU_PARAM_OUTPUT_BIAS, bias), "the output bias is staged");
+
+    read = inferAll(coprocessor, during) && read;
+    check(read && isNand(during) && during[0] == before[0] && during[3] == before[3],
+        "inference uses the active model while staging");
+
+    check(coprocessor.commitModel() && !coprocessor.isUpdatingModel(), "commitModel()");
+    check(inferAll(coprocessor, after) && after[0] < 0.5f && after[1] < 0.5f && after[2] < 0.5f,
+        "inference uses the committed model");
+}
+
+static void checkCheckpoint(N2Coprocessor &coprocessor) {
+    printf("Taking checkpoints in EEPROM...\n");
+
+    uint16_t size = (uint16_t) N2Checkpoint::getRequiredSize(2, 2, 1);
+    N2Checkpoint checkpoint(coprocessor, 0, size);
+
+    checkpoint.begin();
+    checkpoint.clear();
+
+    // Nine parameters make two blocks, the output bias is alone in the second
+    check(checkpoint.save() && checkpoint.getLastWriteCount() == 3, "the first checkpoint writes both blocks");
+    check(checkpoint.save() && checkpoint.getLastWriteCount() == 0, "an unchanged checkpoint writes 0 slots");
+
+    // begin() may have restored a checkpoint of an earlier run
+    float bias[1];
+    coprocessor.getParameter(N2CMU_PARAM_OUTPUT_BIAS, bias);
+    bias[0] += 1.0f;
+
+    coprocessor.setParameter(N2CMU_PARAM_OUTPUT_BIAS, bias);
+    check(checkpoint.save() && checkpoint.getLastWriteCount() == 2, "a new output bias writes one block");
+
+    float weights[4], restored[4];
+    coprocessor.getParameter(N2CMU_PARAM_HIDDEN_WEIGHTS, weights);
+    coprocessor.createNetwork(3, 3, 3);
+
+    N2Checkpoint reader(coprocessor, 0, size);
+    check(reader.begin(), "the checkpoint is restored");
+    check(coprocessor.getHiddenCount() == 2 &&
+        coprocessor.getParameter(N2CMU_PARAM_HIDDEN_WEIGHTS, restored) &&
+        weights[0] == restored[0] && weights[3] == restored[3], "the restored model matches");
+
+    float output[1];
+    check(coprocessor.getParameter(N2CMU_PARAM_OUTPUT_BIAS, output) && output[0] == bias[0],
+        "the restored output bias matches");
+
+    N2Checkpoint small(coprocessor, 0, size - N2CMU_CHECKPOINT_SLOT);
+    check(!small.begin() && small.getSlotCount() == 0 && !small.save(), "a region too small is rejected");
+}
+
+int main(int argc, char **argv) {
+    // Initialize the N2Coprocessor instance on the given serial device
+    N2Coprocessor coprocessor(argc > 1 ? argv[1] : N2CMU_DEVICE_PATH);
+    if(!coprocessor.begin() || !coprocessor.cpuReset()) {
+        fprintf(stderr, "Co-processor initialization failed.\n");
+        return 1;
+    }
+
+    checkOptimizedTraining(coprocessor);
+    checkEvaluation(coprocessor);
+    checkDevicePerf(coprocessor);
+    checkSweep(coprocessor);
+    checkEarlyStopping(coprocessor);
+
+    if(!trainNand(coprocessor, 2)) {
+        fprintf(stderr, "Training failed.\n");
+        return 1;
+    }
+
+    checkModelUpdate(coprocessor);
+    checkCheckpoint(coprocessor);
+
+    printf("%d checks failed.\n", failures);
+    return failures == 0 ? 0 : 1;
+}
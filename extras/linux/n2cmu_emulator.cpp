@@ -0,0 +1,864 @@
+/*
+ * This file is part of the N2CMU Arduino library (https://github.com/nthnn/n2cmu-arduino).
+ * Copyright (c) 2024 Nathanne Isip.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * N2CMU device emulator for Linux hosts.
+ *
+ * Creates a pseudo-terminal pair and serves the N2CMU serial protocol
+ * on its master side, so the library can be exercised end to end over
+ * the slave side without a shield. The slave path is printed on start
+ * and optionally linked to the given path.
+ *
+ *     ./n2cmu_emulator /tmp/n2cmu &
+ *     ./n2cmu_nand_network /tmp/n2cmu
+ *
+ * With --stall-after <n>, the emulator stops responding after serving
+ * n commands, like a hung device, until it receives a CPU reset.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "n2cmu_commands.h"
+
+class N2Emulator {
+private:
+    int fd;
+    long stallAfter;
+    long served;
+
+    uint8_t inputCount, hiddenCount, outputCount;
+    uint16_t epochCount;
+    uint16_t progressInterval;
+
+    uint32_t inferMicros, epochMicros, trainMicros;
+    uint16_t rxHighWater;
+
+    std::vector<float> hiddenNeuron, outputNeuron;
+    std::vector<float> hiddenWeights, outputWeights;
+    std::vector<float> hiddenBias, outputBias;
+    std::vector<float> hiddenGrad, outputGrad;
+
+    // Optimizer state of trainOptimized(), indexed like the
+    // weight and bias parameters starting at hiddenWeights.
+    std::vector<float> velocity[4], batchSums[4];
+
+    bool staging;
+    std::vector<float> staged[8];
+
+    bool readBytes(void *data, size_t length) {
+        uint8_t *ptr = (uint8_t*) data;
+
+        while(length > 0) {
+            ssize_t count = ::read(this->fd, ptr, length);
+
+            if(count < 0 && errno == EINTR)
+                continue;
+            if(count <= 0)
+                return false;
+
+            ptr += count;
+            length -= (size_t) count;
+        }
+
+        return true;
+    }
+
+    void writeBytes(const void *data, size_t length) {
+        const uint8_t *ptr = (const uint8_t*) data;
+
+        while(length > 0) {
+            ssize_t count = ::write(this->fd, ptr, length);
+
+            if(count < 0 && errno == EINTR)
+                continue;
+            if(count <= 0)
+                return;
+
+            ptr += count;
+            length -= (size_t) count;
+        }
+    }
+
+    bool readU8(uint8_t &data) {
+        return this->readBytes(&data, 1);
+    }
+
+    bool readU16(uint16_t &data) {
+        uint8_t buf[2];
+        if(!this->readBytes(buf, 2))
+            return false;
+
+        data = (uint16_t) (buf[0] | (buf[1] << 8));
+        return true;
+    }
+
+    bool readF32(float &data) {
+        return this->readBytes(&data, 4);
+    }
+
+    bool readFloats(std::vector<float> &data, size_t count) {
+        data.resize(count);
+
+        for(size_t i = 0; i < count; i++)
+            if(!this->readF32(data[i]))
+                return false;
+
+        return true;
+    }
+
+    void writeU8(uint8_t data) {
+        this->writeBytes(&data, 1);
+    }
+
+    void writeU16(uint16_t data) {
+        uint8_t buf[2] = {
+            (uint8_t) (data & 0xff),
+            (uint8_t) (data >> 8)
+        };
+
+        this->writeBytes(buf, 2);
+    }
+
+    void writeF32(float data) {
+        this->writeBytes(&data, 4);
+    }
+
+    void writeU32(uint32_t data) {
+        uint8_t buf[4];
+
+        for(uint8_t i = 0; i < 4; i++)
+            buf[i] = (uint8_t) (data >> (8 * i));
+        this->writeBytes(buf, 4);
+    }
+
+    static uint32_t micros() {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        return (uint32_t) (now.tv_sec * 1000000LL + now.tv_nsec / 1000);
+    }
+
+    void trackReceiveBuffer() {
+        int pending = 0;
+
+        if(ioctl(this->fd, FIONREAD, &pending) == 0 &&
+            pending > this->rxHighWater)
+            this->rxHighWater = (uint16_t) pending;
+    }
+
+    void writeFloats(const std::vector<float> &data) {
+        for(size_t i = 0; i < data.size(); i++)
+            this->writeF32(data[i]);
+    }
+
+    static float sigmoid(float x) {
+        return 1.0f / (1.0f + expf(-x));
+    }
+
+    static float randomWeight() {
+        return ((float) rand() / (float) RAND_MAX) - 0.5f;
+    }
+
+    // Active parameter array by N2CMUParameter index.
+    std::vector<float> &active(uint8_t index) {
+        switch(index) {
+            case 0: return this->hiddenNeuron;
+            case 1: return this->outputNeuron;
+            case 2: return this->hiddenWeights;
+            case 3: return this->outputWeights;
+            case 4: return this->hiddenBias;
+            case 5: return this->outputBias;
+            case 6: return this->hiddenGrad;
+            default: return this->outputGrad;
+        }
+    }
+
+    // Parameter array reached by the set and get commands,
+    // the staging slot while a model update is open.
+    std::vector<float> &parameter(uint8_t index) {
+        return this->staging ? this->staged[index] : this->active(index);
+    }
+
+    bool stage() {
+        uint8_t enable;
+        if(!this->readU8(enable))
+            return false;
+
+        this->staging = enable != 0;
+        for(uint8_t i = 0; i < 8; i++)
+            this->staged[i] = this->staging ?
+                this->active(i) : std::vector<float>();
+
+        this->writeU8(1);
+        return true;
+    }
+
+    void commit() {
+        if(!this->staging) {
+            this->writeU8(0);
+            return;
+        }
+
+        for(uint8_t i = 0; i < 8; i++)
+            this->active(i).swap(this->staged[i]);
+
+        this->staging = false;
+        this->writeU8(1);
+    }
+
+    void createNetwork(uint8_t input, uint8_t hidden, uint8_t output) {
+        this->staging = false;
+        this->inputCount = input;
+        this->hiddenCount = hidden;
+        this->outputCount = output;
+
+        this->resetNetwork();
+    }
+
+    void resetNetwork() {
+        this->hiddenNeuron.assign(this->hiddenCount, 0.0f);
+        this->outputNeuron.assign(this->outputCount, 0.0f);
+        this->hiddenGrad.assign(this->hiddenCount, 0.0f);
+        this->outputGrad.assign(this->outputCount, 0.0f);
+
+        this->hiddenWeights.resize(this->inputCount * this->hiddenCount);
+        this->outputWeights.resize(this->hiddenCount * this->outputCount);
+        this->hiddenBias.resize(this->hiddenCount);
+        this->outputBias.resize(this->outputCount);
+
+        for(size_t i = 0; i < this->hiddenWeights.size(); i++)
+            this->hiddenWeights[i] = randomWeight();
+        for(size_t i = 0; i < this->outputWeights.size(); i++)
+            this->outputWeights[i] = randomWeight();
+        for(size_t i = 0; i < this->hiddenBias.size(); i++)
+            this->hiddenBias[i] = randomWeight();
+        for(size_t i = 0; i < this->outputBias.size(); i++)
+            this->outputBias[i] = randomWeight();
+    }
+
+    void forward(const float *input) {
+        for(uint8_t h = 0; h < this->hiddenCount; h++) {
+            float sum = this->hiddenBias[h];
+
+            for(uint8_t i = 0; i < this->inputCount; i++)
+                sum += input[i] * this->hiddenWeights[i * this->hiddenCount + h];
+            this->hiddenNeuron[h] = sigmoid(sum);
+        }
+
+        for(uint8_t o = 0; o < this->outputCount; o++) {
+            float sum = this->outputBias[o];
+
+            for(uint8_t h = 0; h < this->hiddenCount; h++)
+                sum += this->hiddenNeuron[h] *
+                    this->outputWeights[h * this->outputCount + o];
+            this->outputNeuron[o] = sigmoid(sum);
+        }
+    }
+
+    void gradients(const float *target) {
+        for(uint8_t o = 0; o < this->outputCount; o++) {
+            float out = this->outputNeuron[o];
+            this->outputGrad[o] = (target[o] - out) * out * (1.0f - out);
+        }
+
+        for(uint8_t h = 0; h < this->hiddenCount; h++) {
+            float sum = 0.0f;
+
+            for(uint8_t o = 0; o < this->outputCount; o++)
+                sum += this->outputGrad[o] *
+                    this->outputWeights[h * this->outputCount + o];
+
+            float out = this->hiddenNeuron[h];
+            this->hiddenGrad[h] = sum * out * (1.0f - out);
+        }
+    }
+
+    void backward(const float *input, const float *target, float learningRate) {
+        this->gradients(target);
+
+        for(uint8_t h = 0; h < this->hiddenCount; h++)
+            for(uint8_t o = 0; o < this->outputCount; o++)
+                this->outputWeights[h * this->outputCount + o] +=
+                    learningRate * this->outputGrad[o] * this->hiddenNeuron[h];
+
+        for(uint8_t o = 0; o < this->outputCount; o++)
+            this->outputBias[o] += learningRate * this->outputGrad[o];
+
+        for(uint8_t i = 0; i < this->inputCount; i++)
+            for(uint8_t h = 0; h < this->hiddenCount; h++)
+                this->hiddenWeights[i * this->hiddenCount + h] +=
+                    learningRate * this->hiddenGrad[h] * input[i];
+
+        for(uint8_t h = 0; h < this->hiddenCount; h++)
+            this->hiddenBias[h] += learningRate * this->hiddenGrad[h];
+    }
+
+    // Adds the gradient of the last sample to the sums
+    // of the current mini-batch.
+    void accumulate(const float *input) {
+        for(uint8_t i = 0; i < this->inputCount; i++)
+            for(uint8_t h = 0; h < this->hiddenCount; h++)
+                this->batchSums[0][i * this->hiddenCount + h] +=
+                    this->hiddenGrad[h] * input[i];
+
+        for(uint8_t h = 0; h < this->hiddenCount; h++)
+            for(uint8_t o = 0; o < this->outputCount; o++)
+                this->batchSums[1][h * this->outputCount + o] +=
+                    this->outputGrad[o] * this->hiddenNeuron[h];
+
+        for(uint8_t h = 0; h < this->hiddenCount; h++)
+            this->batchSums[2][h] += this->hiddenGrad[h];
+
+        for(uint8_t o = 0; o < this->outputCount; o++)
+            this->batchSums[3][o] += this->outputGrad[o];
+    }
+
+    // Applies the mean gradient of a mini-batch through the
+    // momentum term, v = momentum * v + rate * g and w += v.
+    void applyBatch(float learningRate, float momentum, uint16_t count) {
+        for(uint8_t k = 0; k < 4; k++) {
+            std::vector<float> &values = this->active(k + 2);
+
+            for(size_t i = 0; i < values.size(); i++) {
+                this->velocity[k][i] = momentum * this->velocity[k][i] +
+                    learningRate * this->batchSums[k][i] / (float) count;
+
+                values[i] += this->velocity[k][i];
+                this->batchSums[k][i] = 0.0f;
+            }
+        }
+    }
+
+    bool readDataset(
+        uint16_t &len,
+        std::vector<float> &data,
+        std::vector<float> &output
+    ) {
+        return this->readU16(len) &&
+            this->readFloats(data, (size_t) len * this->inputCount) &&
+            this->readFloats(output, (size_t) len * this->outputCount);
+    }
+
+    float runEpoch(
+        const std::vector<float> &data,
+        const std::vector<float> &output,
+        uint16_t len,
+        float learningRate,
+        float momentum = 0.0f,
+        uint16_t batchSize = 0
+    ) {
+        uint32_t start = micros();
+        float squaredError = 0.0f;
+
+        // Plain per-sample SGD unless trainOptimized() asks
+        // for momentum or mini-batches.
+        bool plain = momentum == 0.0f && batchSize <= 1;
+        uint16_t pending = 0;
+
+        for(uint16_t j = 0; j < len; j++) {
+            this->forward(&data[j * this->inputCount]);
+
+            for(uint8_t o = 0; o < this->outputCount; o++) {
+                float error = output[j * this->outputCount + o] -
+                    this->outputNeuron[o];
+                squaredError += error * error;
+            }
+
+            if(plain) {
+                this->backward(
+                    &data[j * this->inputCount],
+                    &output[j * this->outputCount],
+                    learningRate
+                );
+                continue;
+            }
+
+            this->gradients(&output[j * this->outputCount]);
+            this->accumulate(&data[j * this->inputCount]);
+
+            if(++pending >= batchSize) {
+                this->applyBatch(learningRate, momentum, pending);
+                pending = 0;
+            }
+        }
+
+        if(pending > 0)
+            this->applyBatch(learningRate, momentum, pending);
+
+        this->epochMicros = micros() - start;
+        return len > 0 && this->outputCount > 0 ?
+            squaredError / (float) (len * this->outputCount) : 0.0f;
+    }
+
+    // Sends a progress frame (0x02, epoch, loss) when the epoch
+    // falls on the progress interval and waits for the host to
+    // answer whether training should continue.
+    bool reportProgress(uint16_t epoch, float loss) {
+        if(this->progressInterval == 0 || epoch % this->progressInterval != 0)
+            return true;
+
+        uint8_t proceed;
+        this->writeU8(0x02);
+        this->writeU16(epoch);
+        this->writeF32(loss);
+
+        return this->readU8(proceed) && proceed != 0;
+    }
+
+    bool train() {
+        uint16_t len;
+        std::vector<float> data, output;
+        float learningRate;
+
+        if(!this->readDataset(len, data, output) ||
+            !this->readF32(learningRate))
+            return false;
+
+        uint32_t start = micros();
+        for(uint16_t epoch = 0; epoch < this->epochCount; epoch++) {
+            float loss = this->runEpoch(data, output, len, learningRate);
+            if(!this->reportProgress(epoch + 1, loss))
+                break;
+        }
+        this->trainMicros = micros() - start;
+
+        this->writeU8(this->epochCount > 0);
+        return true;
+    }
+
+    bool trainOptimized() {
+        uint16_t len, decayStep, batchSize;
+        std::vector<float> data, output;
+        float learningRate, momentum, decayRate;
+        uint8_t schedule;
+
+        if(!this->readDataset(len, data, output) ||
+            !this->readF32(learningRate) ||
+            !this->readF32(momentum) ||
+            !this->readU8(schedule) ||
+            !this->readF32(decayRate) ||
+            !this->readU16(decayStep) ||
+            !this->readU16(batchSize))
+            return false;
+
+        for(uint8_t k = 0; k < 4; k++) {
+            this->velocity[k].assign(this->active(k + 2).size(), 0.0f);
+            this->batchSums[k].assign(this->active(k + 2).size(), 0.0f);
+        }
+
+        uint32_t start = micros();
+        for(uint16_t epoch = 0; epoch < this->epochCount; epoch++) {
+            float rate = learningRate;
+
+            if(schedule == 0x01 && decayStep > 0)
+                rate *= powf(decayRate, (float) (epoch / decayStep));
+            else if(schedule == 0x02 && decayStep > 0)
+                rate *= powf(decayRate, (float) epoch / (float) decayStep);
+
+            float loss = this->runEpoch(
+                data,
+                output,
+                len,
+                rate,
+                momentum,
+                batchSize
+            );
+
+            if(!this->reportProgress(epoch + 1, loss))
+                break;
+        }
+        this->trainMicros = micros() - start;
+
+        this->writeU8(this->epochCount > 0);
+        return true;
+    }
+
+    float validationError(
+        const std::vector<float> &data,
+        const std::vector<float> &output,
+        uint16_t first,
+        uint16_t len
+    ) {
+        float squaredError = 0.0f;
+
+        for(uint16_t j = first; j < len; j++) {
+            this->forward(&data[j * this->inputCount]);
+
+            for(uint8_t o = 0; o < this->outputCount; o++) {
+                float error = output[j * this->outputCount + o] -
+                    this->outputNeuron[o];
+                squaredError += error * error;
+            }
+        }
+
+        return squaredError / (float) ((len - first) * this->outputCount);
+    }
+
+    bool sweep() {
+        uint16_t len, validationCount;
+        std::vector<float> data, output;
+        uint8_t configCount;
+
+        if(!this->readDataset(len, data, output) ||
+            !this->readU16(validationCount) ||
+            !this->readU8(configCount))
+            return false;
+
+        std::vector<uint8_t> hidden(configCount);
+        std::vector<float> rates(configCount);
+        std::vector<uint16_t> epochs(configCount);
+
+        for(uint8_t i = 0; i < configCount; i++)
+            if(!this->readU8(hidden[i]) ||
+                !this->readF32(rates[i]) ||
+                !this->readU16(epochs[i]))
+                return false;
+
+        if(validationCount == 0 || validationCount >= len) {
+            this->writeU8(0);
+            return true;
+        }
+
+        uint16_t trainCount = len - validationCount;
+        uint8_t best = 0;
+        float bestError = 0.0f;
+        std::vector<float> bestParameters[4];
+
+        for(uint8_t i = 0; i < configCount; i++) {
+            this->createNetwork(this->inputCount, hidden[i], this->outputCount);
+
+            for(uint16_t epoch = 0; epoch < epochs[i]; epoch++)
+                this->runEpoch(data, output, trainCount, rates[i]);
+
+            float error = this->validationError(data, output, trainCount, len);
+            this->writeF32(error);
+
+            if(i == 0 || error < bestError) {
+                best = i;
+                bestError = error;
+
+                bestParameters[0] = this->hiddenWeights;
+                bestParameters[1] = this->outputWeights;
+                bestParameters[2] = this->hiddenBias;
+                bestParameters[3] = this->outputBias;
+            }
+        }
+
+        this->createNetwork(this->inputCount, hidden[best], this->outputCount);
+        this->epochCount = epochs[best];
+
+        this->hiddenWeights = bestParameters[0];
+        this->outputWeights = bestParameters[1];
+        this->hiddenBias = bestParameters[2];
+        this->outputBias = bestParameters[3];
+
+        this->writeU8(best);
+        this->writeU8(1);
+
+        return true;
+    }
+
+    bool infer() {
+        std::vector<float> input;
+        if(!this->readFloats(input, this->inputCount))
+            return false;
+
+        uint32_t start = micros();
+        this->forward(input.data());
+        this->inferMicros = micros() - start;
+
+        this->writeFloats(this->outputNeuron);
+        this->writeU8(1);
+
+        return true;
+    }
+
+    bool evaluate() {
+        uint16_t len;
+        std::vector<float> data, output;
+        uint8_t confusion;
+
+        if(!this->readDataset(len, data, output) ||
+            !this->readU8(confusion))
+            return false;
+
+        float squaredError = 0.0f;
+        uint16_t correct = 0, counts[4] = {0, 0, 0, 0};
+
+        for(uint16_t j = 0; j < len; j++) {
+            const float *target = &output[j * this->outputCount];
+            this->forward(&data[j * this->inputCount]);
+
+            uint8_t predicted = 0, expected = 0;
+            for(uint8_t o = 0; o < this->outputCount; o++) {
+                float error = target[o] - this->outputNeuron[o];
+                squaredError += error * error;
+
+                if(this->outputNeuron[o] > this->outputNeuron[predicted])
+                    predicted = o;
+                if(target[o] > target[expected])
+                    expected = o;
+
+                bool positive = this->outputNeuron[o] > 0.5f;
+                bool actual = target[o] > 0.5f;
+                counts[positive ? (actual ? 0 : 1) : (actual ? 3 : 2)]++;
+            }
+
+            if(this->outputCount == 1 ?
+                (this->outputNeuron[0] > 0.5f) == (target[0] > 0.5f) :
+                predicted == expected)
+                correct++;
+        }
+
+        uint32_t total = (uint32_t) len * this->outputCount;
+        this->writeF32(total == 0 ? 0.0f : squaredError / (float) total);
+        this->writeF32(len == 0 ? 0.0f : (float) correct / (float) len);
+
+        if(confusion)
+            for(uint8_t i = 0; i < 4; i++)
+                this->writeU16(counts[i]);
+
+        this->writeU8(1);
+        return true;
+    }
+
+    bool setFloats(std::vector<float> &data) {
+        std::vector<float> values;
+        if(!this->readFloats(values, data.size()))
+            return false;
+
+        data = values;
+        this->writeU8(1);
+
+        return true;
+    }
+
+public:
+    N2Emulator(int fd, long stallAfter):
+        fd(fd), stallAfter(stallAfter), served(0),
+        inputCount(0), hiddenCount(0),
+        outputCount(0), epochCount(0), progressInterval(0),
+        inferMicros(0), epochMicros(0),
+        trainMicros(0), rxHighWater(0), staging(false) { }
+
+    bool serve() {
+        uint8_t command, value;
+        uint16_t epoch;
+
+        this->trackReceiveBuffer();
+        if(!this->readU8(command))
+            return false;
+
+        if(this->stallAfter >= 0 && this->served++ >= this->stallAfter) {
+            if(command != N2CMU_PROC_CPU_RESET)
+                return true;
+
+            fprintf(stderr, "n2cmu_emulator: reset while stalled\n");
+            this->stallAfter = -1;
+        }
+
+        switch(command) {
+            case N2CMU_PROC_HANDSHAKE:
+                this->writeU8(1);
+                return true;
+
+            case N2CMU_PROC_CPU_RESET:
+                this->epochCount = 0;
+                this->progressInterval = 0;
+                this->createNetwork(0, 0, 0);
+                return true;
+
+            case N2CMU_NET_CREATE: {
+                uint8_t topology[3];
+                if(!this->readBytes(topology, 3))
+                    return false;
+
+                this->createNetwork(topology[0], topology[1], topology[2]);
+                return true;
+            }
+
+            case N2CMU_NET_RESET:
+                this->resetNetwork();
+                return true;
+
+            case N2CMU_NET_TRAIN:
+                return this->train();
+
+            case N2CMU_NET_TRAIN_OPTIMIZED:
+                return this->trainOptimized();
+
+            case N2CMU_NET_INFER:
+                return this->infer();
+
+            case N2CMU_NET_EVALUATE:
+                return this->evaluate();
+
+            case N2CMU_NET_SWEEP:
+                return this->sweep();
+
+            case N2CMU_SET_INPUT_COUNT:
+                if(!this->readU8(value))
+                    return false;
+
+                this->createNetwork(value, this->hiddenCount, this->outputCount);
+                return true;
+
+            case N2CMU_SET_HIDDEN_COUNT:
+                if(!this->readU8(value))
+                    return false;
+
+                this->createNetwork(this->inputCount, value, this->outputCount);
+                return true;
+
+            case N2CMU_SET_OUTPUT_COUNT:
+                if(!this->readU8(value))
+                    return false;
+
+                this->createNetwork(this->inputCount, this->hiddenCount, value);
+                return true;
+
+            case N2CMU_SET_HIDDEN_NEURON: return this->setFloats(this->parameter(0));
+            case N2CMU_SET_OUTPUT_NEURON: return this->setFloats(this->parameter(1));
+            case N2CMU_SET_HIDDEN_WEIGHTS: return this->setFloats(this->parameter(2));
+            case N2CMU_SET_OUTPUT_WEIGHTS: return this->setFloats(this->parameter(3));
+            case N2CMU_SET_HIDDEN_BIAS: return this->setFloats(this->parameter(4));
+            case N2CMU_SET_OUTPUT_BIAS: return this->setFloats(this->parameter(5));
+            case N2CMU_SET_HIDDEN_GRAD: return this->setFloats(this->parameter(6));
+            case N2CMU_SET_OUTPUT_GRAD: return this->setFloats(this->parameter(7));
+
+            case N2CMU_SET_EPOCH_COUNT:
+                if(!this->readU16(epoch))
+                    return false;
+
+                this->epochCount = epoch;
+                return true;
+
+            case N2CMU_MODEL_STAGE:
+                return this->stage();
+
+            case N2CMU_MODEL_COMMIT:
+                this->commit();
+                return true;
+
+            case N2CMU_SET_PROGRESS_INTERVAL:
+                if(!this->readU16(epoch))
+                    return false;
+
+                this->progressInterval = epoch;
+                return true;
+
+            case N2CMU_GET_INPUT_COUNT: this->writeU8(this->inputCount); return true;
+            case N2CMU_GET_HIDDEN_COUNT: this->writeU8(this->hiddenCount); return true;
+            case N2CMU_GET_OUTPUT_COUNT: this->writeU8(this->outputCount); return true;
+            case N2CMU_GET_HIDDEN_NEURON: this->writeFloats(this->parameter(0)); return true;
+            case N2CMU_GET_OUTPUT_NEURON: this->writeFloats(this->parameter(1)); return true;
+            case N2CMU_GET_HIDDEN_WEIGHTS: this->writeFloats(this->parameter(2)); return true;
+            case N2CMU_GET_OUTPUT_WEIGHTS: this->writeFloats(this->parameter(3)); return true;
+            case N2CMU_GET_HIDDEN_BIAS: this->writeFloats(this->parameter(4)); return true;
+            case N2CMU_GET_OUTPUT_BIAS: this->writeFloats(this->parameter(5)); return true;
+            case N2CMU_GET_HIDDEN_GRAD: this->writeFloats(this->parameter(6)); return true;
+            case N2CMU_GET_OUTPUT_GRAD: this->writeFloats(this->parameter(7)); return true;
+            case N2CMU_GET_EPOCH_COUNT: this->writeU16(this->epochCount); return true;
+
+            case N2CMU_GET_PERF:
+                this->writeU32(this->inferMicros);
+                this->writeU32(this->epochMicros);
+                this->writeU32(this->trainMicros);
+                this->writeU16(this->rxHighWater);
+                this->writeU16(0);
+                return true;
+
+            default:
+                fprintf(stderr, "n2cmu_emulator: unknown command 0x%02x\n", command);
+                return true;
+        }
+    }
+};
+
+static const char *linkPath = NULL;
+
+static void removeLink(int signal) {
+    if(linkPath != NULL)
+        unlink(linkPath);
+
+    _exit(signal == 0 ? 0 : 128 + signal);
+}
+
+int main(int argc, char **argv) {
+    long stallAfter = -1;
+
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], "--stall-after") == 0 && i + 1 < argc)
+            stallAfter = atol(argv[++i]);
+        else linkPath = argv[i];
+    }
+
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if(master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        perror("n2cmu_emulator: posix_openpt");
+        return 1;
+    }
+
+    const char *slavePath = ptsname(master);
+
+    // Keep the slave side open so reads on the master side block,
+    // instead of failing, while no host is connected.
+    int slave = open(slavePath, O_RDWR | O_NOCTTY);
+    if(slave < 0) {
+        perror("n2cmu_emulator: open");
+        return 1;
+    }
+
+    struct termios tty;
+    tcgetattr(slave, &tty);
+    cfmakeraw(&tty);
+    tcsetattr(slave, TCSANOW, &tty);
+
+    if(linkPath != NULL) {
+        unlink(linkPath);
+
+        if(symlink(slavePath, linkPath) != 0) {
+            perror("n2cmu_emulator: symlink");
+            return 1;
+        }
+
+        signal(SIGINT, removeLink);
+        signal(SIGTERM, removeLink);
+    }
+
+    printf("%s\n", slavePath);
+    fflush(stdout);
+
+    N2Emulator emulator(master, stallAfter);
+    while(emulator.serve());
+
+    removeLink(0);
+    return 0;
+}
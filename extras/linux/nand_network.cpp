@@ -0,0 +1,113 @@
+/*
+ * This file is part of the N2CMU Arduino library (https://github.com/nthnn/n2cmu-arduino).
+ * Copyright (c) 2024 Nathanne Isip.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+
+#include <n2cmu.h>
+
+// Write a float array as a JSON member
+static void writeArray(FILE *file, const char *name, const float *values, int count, bool last) {
+    fprintf(file, "    \"%s\": [", name);
+
+    for(int i = 0; i < count; i++)
+        fprintf(file, "%s%.9g", i == 0 ? "" : ", ", values[i]);
+    fprintf(file, "]%s\n", last ? "" : ",");
+}
+
+// Save the trained model in the format read by extras/tools/n2cmu_model2header.py
+static bool saveModel(N2Coprocessor &coprocessor, const char *path) {
+    FILE *file = fopen(path, "w");
+    if(file == NULL)
+        return false;
+
+    float hiddenWeights[4], outputWeights[2], hiddenBias[2], outputBias[1];
+    coprocessor.getHiddenWeights(hiddenWeights);
+    coprocessor.getOutputWeights(outputWeights);
+    coprocessor.getHiddenBias(hiddenBias);
+    coprocessor.getOutputBias(outputBias);
+
+    fprintf(file, "{\n");
+    fprintf(file, "    \"inputCount\": 2,\n    \"hiddenCount\": 2,\n    \"outputCount\": 1,\n");
+    fprintf(file, "    \"epochCount\": %u,\n", coprocessor.getEpochCount());
+    writeArray(file, "hiddenWeights", hiddenWeights, 4, false);
+    writeArray(file, "outputWeights", outputWeights, 2, false);
+    writeArray(file, "hiddenBias", hiddenBias, 2, false);
+    writeArray(file, "outputBias", outputBias, 1, true);
+    fprintf(file, "}\n");
+
+    return fclose(file) == 0;
+}
+
+int main(int argc, char **argv) {
+    // Initialize the N2Coprocessor instance on the given serial device
+    N2Coprocessor coprocessor(argc > 1 ? argv[1] : N2CMU_DEVICE_PATH);
+    if(!coprocessor.begin()) {
+        fprintf(stderr, "Co-processor initialization failed.\n");
+        return 1;
+    }
+
+    // Reset the CPU
+    if(!coprocessor.cpuReset()) {
+        fprintf(stderr, "CPU reset failed.\n");
+        return 1;
+    }
+
+    // Initialize neural network with 2 input, 2 hidden, and 1 output neurons
+    printf("Initializing neural network...\n");
+    coprocessor.createNetwork(2, 2, 1);
+    coprocessor.setEpochCount(4000);
+
+    // Define training dataset and corresponding output
+    float dataset[][2] = {{0, 0}, {0, 1}, {1, 0}, {1, 1}};
+    float output[][1] = {{1}, {1}, {1}, {0}};
+
+    // Start network training
+    printf("Starting network training...\n");
+    if(!coprocessor.train((float*) dataset, (float*) output, 4, 1.0f)) {
+        fprintf(stderr, "Training failed.\n");
+        return 1;
+    }
+
+    // Perform inferences
+    printf("Attempting inferences...\n");
+    for(uint8_t i = 0; i < 4; i++) {
+        float result[1];
+
+        if(!coprocessor.infer(dataset[i], result)) {
+            fprintf(stderr, "Inference attempt failed.\n");
+            return 1;
+        }
+
+        printf("\t[%.2f, %.2f]: %.2f\n", dataset[i][0], dataset[i][1], result[0]);
+    }
+
+    // Optionally save the trained model
+    if(argc > 2) {
+        if(!saveModel(coprocessor, argv[2])) {
+            fprintf(stderr, "Saving the model failed.\n");
+            return 1;
+        }
+
+        printf("Model saved to %s.\n", argv[2]);
+    }
+
+    // Reset the network
+    printf("Inference done, resetting network.\n");
+    coprocessor.resetNetwork();
+
+    return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * This file is part of the N2CMU Arduino library (https://github.com/nthnn/n2cmu-arduino).
+ * Copyright (c) 2024 Nathanne Isip.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Checks recovery from a hung device. Run it against an emulator started
+// with --stall-after, so the device stops answering in the middle of the
+// repeated inferences or parameter reads:
+//
+//     ./n2cmu_emulator --stall-after 40 /tmp/n2cmu &
+//     ./n2cmu_recovery_check infer /tmp/n2cmu
+
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+
+#include <n2cmu.h>
+
+#define TIMEOUT 250
+#define ROUND_COUNT 20
+
+static float dataset[][2] = {{0, 0}, {0, 1}, {1, 0}, {1, 1}};
+static float output[][1] = {{1}, {1}, {1}, {0}};
+
+// Run one inference over the whole truth table, or read the hidden weights
+static bool run(N2Coprocessor &coprocessor, bool infer, float *values) {
+    if(!infer)
+        return coprocessor.getParameter(N2CMU_PARAM_HIDDEN_WEIGHTS, values);
+
+    for(uint8_t i = 0; i < 4; i++)
+        if(!coprocessor.infer(dataset[i], values + i))
+            return false;
+
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if(argc < 3 || (strcmp(argv[1], "infer") != 0 && strcmp(argv[1], "get") != 0)) {
+        fprintf(stderr, "Usage: %s infer|get <device>\n", argv[0]);
+        return 2;
+    }
+
+    bool infer = strcmp(argv[1], "infer") == 0;
+
+    // Initialize the N2Coprocessor instance with short timeouts
+    N2Coprocessor coprocessor(argv[2]);
+    coprocessor.setTimeout(TIMEOUT, 10000);
+
+    if(!coprocessor.begin() || !coprocessor.cpuReset()) {
+        fprintf(stderr, "Co-processor initialization failed.\n");
+        return 1;
+    }
+
+    // Train a NAND network and keep a snapshot of it
+    printf("Training NAND network...\n");
+    coprocessor.createNetwork(2, 2, 1);
+    coprocessor.setEpochCount(4000);
+
+    if(!coprocessor.train((float*) dataset, (float*) output, 4, 1.0f) ||
+        !coprocessor.setRecovery(true)) {
+        fprintf(stderr, "Training failed.\n");
+        return 1;
+    }
+
+    float expected[4];
+    if(!run(coprocessor, infer, expected)) {
+        fprintf(stderr, "Reading the reference values failed.\n");
+        return 1;
+    }
+
+    // The device hangs during one of these rounds and is recovered
+    printf("Running %d rounds of %s...\n", ROUND_COUNT, infer ? "inferences" : "weight reads");
+    long longest = 0;
+    int failed = 0;
+
+    for(int round = 0; round < ROUND_COUNT; round++) {
+        float values[4];
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        bool result = run(coprocessor, infer, values);
+        long elapsed = (long) std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start
+        ).count();
+
+        if(elapsed > longest)
+            longest = elapsed;
+
+        if(!result || memcmp(values, expected, sizeof(expected)) != 0) {
+            fprintf(stderr, "\tRound %d returned wrong values.\n", round);
+            failed++;
+        }
+    }
+
+    // A stalled round costs its first timeout, the timed out
+    // handshake and the restore, but never a timeout per read.
+    printf("\t%d rounds failed, longest round took %ld ms.\n", failed, longest);
+    if(longest < TIMEOUT) {
+        fprintf(stderr, "The device never stalled.\n");
+        return 1;
+    }
+
+    if(longest > 3 * TIMEOUT) {
+        fprintf(stderr, "Recovery took longer than %d ms.\n", 3 * TIMEOUT);
+        return 1;
+    }
+
+    return failed == 0 ? 0 : 1;
+}
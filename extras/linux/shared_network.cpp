@@ -0,0 +1,92 @@
+/*
+ * This file is part of the N2CMU Arduino library (https://github.com/nthnn/n2cmu-arduino).
+ * Copyright (c) 2024 Nathanne Isip.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <n2cmu.h>
+#include <n2cmu_shared.h>
+
+#define THREAD_COUNT 4
+#define ROUND_COUNT 25
+
+static float dataset[][2] = {{0, 0}, {0, 1}, {1, 0}, {1, 1}};
+static float output[][1] = {{1}, {1}, {1}, {0}};
+
+int main(int argc, char **argv) {
+    // Initialize the N2Coprocessor instance on the given serial device
+    N2Coprocessor coprocessor(argc > 1 ? argv[1] : N2CMU_DEVICE_PATH);
+    if(!coprocessor.begin() || !coprocessor.cpuReset()) {
+        fprintf(stderr, "Co-processor initialization failed.\n");
+        return 1;
+    }
+
+    // Train a NAND network before sharing the co-processor
+    printf("Training NAND network...\n");
+    coprocessor.createNetwork(2, 2, 1);
+    coprocessor.setEpochCount(4000);
+
+    if(!coprocessor.train((float*) dataset, (float*) output, 4, 1.0f)) {
+        fprintf(stderr, "Training failed.\n");
+        return 1;
+    }
+
+    // From here on, only the shared front end touches the co-processor
+    coprocessor.setInferenceCache(4);
+    N2SharedCoprocessor shared(coprocessor);
+    shared.start();
+
+    std::atomic<int> correct(0), failed(0);
+    std::vector<std::thread> threads;
+
+    // Each thread runs inferences over the whole truth table
+    printf("Running inferences from %d threads...\n", THREAD_COUNT);
+    for(int t = 0; t < THREAD_COUNT; t++)
+        threads.push_back(std::thread([&, t]() {
+            for(int round = 0; round < ROUND_COUNT; round++) {
+                int i = (t + round) % 4;
+                float result[1];
+
+                if(!shared.infer(dataset[i], result).get())
+                    failed++;
+                else if((result[0] > 0.5f) == (output[i][0] > 0.5f))
+                    correct++;
+            }
+        }));
+
+    // Tasks are serialized with the inferences
+    uint16_t epochCount = 0;
+    bool taskResult = shared.submit([&](N2Coprocessor& device) -> bool {
+        epochCount = device.getEpochCount();
+        return epochCount != 0;
+    }).get();
+
+    for(std::thread& thread : threads)
+        thread.join();
+    shared.stop();
+
+    int total = THREAD_COUNT * ROUND_COUNT;
+    printf("\t%d of %d inferences correct, %d failed.\n", correct.load(), total, failed.load());
+    printf("\tEpoch count read by a task: %u.\n", epochCount);
+    printf("\tCache hits: %u, misses: %u.\n",
+        coprocessor.getCacheHits(), coprocessor.getCacheMisses());
+
+    return correct.load() == total && taskResult ? 0 : 1;
+}
@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+#
+# This file is part of the N2CMU Arduino library (https://github.com/nthnn/n2cmu-arduino).
+# Copyright (c) 2024 Nathanne Isip.
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, version 3.
+#
+# This program is distributed in the hope that it will be useful, but
+# WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+"""Turn a saved N2CMU model into a header of PROGMEM arrays.
+
+The saved model is a JSON object with the topology, the epoch count and
+the weights and biases as read back with the N2Coprocessor get functions:
+
+    {
+        "inputCount": 2, "hiddenCount": 2, "outputCount": 1,
+        "epochCount": 4000,
+        "hiddenWeights": [...], "outputWeights": [...],
+        "hiddenBias": [...], "outputBias": [...]
+    }
+
+The generated header declares an N2ProgmemModel for loadFromProgmem():
+
+    n2cmu_model2header.py nand.json nand_model > nand_model.h
+"""
+
+import json
+import os
+import re
+import sys
+
+PARAMETERS = (
+    ("hiddenWeights", "hidden_weights", lambda m: m["inputCount"] * m["hiddenCount"]),
+    ("outputWeights", "output_weights", lambda m: m["hiddenCount"] * m["outputCount"]),
+    ("hiddenBias", "hidden_bias", lambda m: m["hiddenCount"]),
+    ("outputBias", "output_bias", lambda m: m["outputCount"]),
+)
+
+
+def format_array(name, values):
+    lines = []
+    for i in range(0, len(values), 4):
+        lines.append("    " + ", ".join(repr(float(v)) + "f" for v in values[i:i + 4]))
+
+    return "static const float %s[] PROGMEM = {\n%s\n};\n" % (name, ",\n".join(lines))
+
+
+def generate(model, name, source):
+    for key in ("inputCount", "hiddenCount", "outputCount"):
+        if not 0 < int(model[key]) < 256:
+            raise ValueError("%s must be between 1 and 255" % key)
+
+    guard = re.sub(r"[^A-Za-z0-9]", "_", name).upper() + "_H"
+    out = [
+        "// Generated by n2cmu_model2header.py from %s. Do not edit.\n" % source,
+        "#ifndef %s\n#define %s\n\n#include <n2cmu.h>\n\n" % (guard, guard),
+    ]
+
+    names = []
+    for key, suffix, size in PARAMETERS:
+        values = model[key]
+        if len(values) != size(model):
+            raise ValueError("%s must have %d values, got %d" % (key, size(model), len(values)))
+
+        names.append("%s_%s" % (name, suffix))
+        out.append(format_array(names[-1], values) + "\n")
+
+    out.append(
+        "static const N2ProgmemModel %s PROGMEM = {\n"
+        "    %d, %d, %d, %d,\n"
+        "    {%s}\n"
+        "};\n\n#endif\n" % (
+            name,
+            model["inputCount"],
+            model["hiddenCount"],
+            model["outputCount"],
+            model.get("epochCount", 0),
+            ", ".join(names),
+        )
+    )
+
+    return "".join(out)
+
+
+def main(argv):
+    if len(argv) != 3:
+        sys.stderr.write("usage: %s <model.json> <name>\n" % argv[0])
+        return 1
+
+    with open(argv[1]) as source:
+        model = json.load(source)
+
+    try:
+        sys.stdout.write(generate(model, argv[2], os.path.basename(argv[1])))
+    except (KeyError, ValueError) as error:
+        sys.stderr.write("%s: invalid model: %s\n" % (argv[0], error))
+        return 1
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -15,7 +15,13 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#ifdef ARDUINO
 #include <Arduino.h>
+#else
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#endif
 
 #include "n2cmu.h"
 #include "n2cmu_commands.h"
@@ -25,23 +31,139 @@ void N2Coprocessor::writeData(const uint8_t *data, uint8_t length) {
         this->n2serial->write(data[i]);
 }
 
+void N2Coprocessor::initialize() {
+    this->timeout = N2CMU_RESPONSE_TIMEOUT;
+    this->trainingTimeout = 0;
+    this->timedOut = false;
+    this->busy = false;
+    this->staging = false;
+    this->stagingLost = false;
+
+    this->monitor.interval = 0;
+    this->monitor.callback = NULL;
+    this->monitor.context = NULL;
+    this->monitor.lossThreshold = 0.0f;
+    this->monitor.patience = 0;
+    this->monitor.minDelta = 0.0f;
+
+    this->recovering = false;
+    this->recoveryHandler = NULL;
+    this->cacheHandler = NULL;
+
+    this->shadow.inputCount = 0;
+    this->shadow.hiddenCount = 0;
+    this->shadow.outputCount = 0;
+    this->shadow.epochCount = 0;
+    this->shadow.validMask = 0;
+
+    for(uint8_t i = 0; i < N2CMU_SNAPSHOT_PARAMS; i++)
+        this->shadow.parameters[i] = NULL;
+
+    this->cache.capacity = 0;
+    this->cache.count = 0;
+    this->cache.inputCount = 0;
+    this->cache.outputCount = 0;
+    this->cache.quantization = 0.0f;
+    this->cache.tick = 0;
+    this->cache.hits = 0;
+    this->cache.misses = 0;
+    this->cache.keys = NULL;
+    this->cache.stamps = NULL;
+    this->cache.inputs = NULL;
+    this->cache.outputs = NULL;
+}
+
+N2Coprocessor::~N2Coprocessor() {
+    this->notifyRecovery(N2CMU_EVENT_RELEASE);
+
+    if(this->cacheHandler != NULL)
+        this->cacheHandler(this, N2CMU_EVENT_RELEASE, NULL, NULL, 0, 0);
+
+    delete this->n2serial;
+}
+
+bool N2Coprocessor::waitFor(uint8_t count, unsigned long wait) {
+    // Once a response is lost, the rest of it will not
+    // come either, so the operation fails without waiting.
+    if(this->busy && this->timedOut)
+        return false;
+
+    unsigned long start = millis();
+
+    while(this->n2serial->available() < count)
+        if(wait != 0 && millis() - start >= wait) {
+            this->timedOut = true;
+            this->flush();
+
+            return false;
+        }
+
+    return true;
+}
+
+void N2Coprocessor::flush() {
+    while(this->n2serial->available() > 0)
+        this->n2serial->read();
+}
+
 bool N2Coprocessor::getResultStatus() {
-    while(!this->n2serial->available());
+    if(!this->waitFor(1, this->timeout))
+        return false;
+
     return this->n2serial->read() == 1;
 }
 
+bool N2Coprocessor::getTrainingStatus() {
+    float bestLoss = 0.0f;
+    uint16_t stale = 0, frames = 0;
+
+    while(true) {
+        if(!this->waitFor(1, this->trainingTimeout))
+            return false;
+
+        uint8_t status = (uint8_t) this->n2serial->read();
+        if(status != N2CMU_PROGRESS_FRAME)
+            return status == 1;
+
+        uint16_t epoch = this->readU16();
+        float loss = this->readF32();
+        if(this->timedOut)
+            return false;
+
+        bool proceed = this->monitor.callback == NULL ||
+            this->monitor.callback(epoch, loss, this->monitor.context);
+
+        if(this->monitor.lossThreshold > 0.0f &&
+            loss < this->monitor.lossThreshold)
+            proceed = false;
+
+        if(frames++ == 0 || loss < bestLoss - this->monitor.minDelta) {
+            bestLoss = loss;
+            stale = 0;
+        }
+        else if(this->monitor.patience > 0 &&
+            ++stale >= this->monitor.patience)
+            proceed = false;
+
+        this->n2serial->write((uint8_t) proceed);
+    }
+}
+
 bool N2Coprocessor::sendCommand(uint8_t command) {
     this->n2serial->write(command);
     return this->getResultStatus();
 }
 
 uint8_t N2Coprocessor::readU8() {
-    while(this->n2serial->available() != 1);
+    if(!this->waitFor(1, this->timeout))
+        return 0;
+
     return (uint8_t) this->n2serial->read();
 }
 
 uint16_t N2Coprocessor::readU16() {
-    while(this->n2serial->available() != 2);
+    if(!this->waitFor(2, this->timeout))
+        return 0;
 
     uint8_t array[2];
     array[0] = (uint8_t) this->n2serial->read();
@@ -54,8 +176,20 @@ uint16_t N2Coprocessor::readU16() {
     return num;
 }
 
+uint32_t N2Coprocessor::readU32() {
+    if(!this->waitFor(4, this->timeout))
+        return 0;
+
+    uint32_t num = 0;
+    for(uint8_t i = 0; i < 4; i++)
+        num |= ((uint32_t) (uint8_t) this->n2serial->read()) << (8 * i);
+
+    return num;
+}
+
 float N2Coprocessor::readF32() {
-    while(this->n2serial->available() != 4);
+    if(!this->waitFor(4, this->timeout))
+        return 0.0f;
 
     float num;
     uint8_t *ptr = (uint8_t*) &num;
@@ -83,21 +217,297 @@ void N2Coprocessor::writeF32(float data) {
     this->writeData(buf, 4);
 }
 
-bool N2Coprocessor::begin() {
-    this->n2serial->begin(31250);
+void N2Coprocessor::writeDataset(
+    float* data,
+    float* output,
+    uint16_t len,
+    uint8_t inputCount,
+    uint8_t outputCount
+) {
+    this->writeU16(len);
+
+    for(uint16_t j = 0; j < len; j++)
+        for(uint8_t k = 0; k < inputCount; k++)
+            this->writeF32(data[j * inputCount + k]);
+
+    for(uint16_t j = 0; j < len; j++)
+        for(uint8_t k = 0; k < outputCount; k++)
+            this->writeF32(output[j * outputCount + k]);
+}
 
+bool N2Coprocessor::begin() {
+#ifdef ARDUINO
+    this->n2serial->begin(N2CMU_BAUD_RATE);
     while(!this->n2serial);
+#else
+    if(!this->n2serial->begin())
+        return false;
+#endif
+
     return this->handshake();
-  }
+}
 
 bool N2Coprocessor::handshake() {
     return this->sendCommand(N2CMU_PROC_HANDSHAKE);
 }
 
+void N2Coprocessor::setTimeout(unsigned long timeout, unsigned long trainingTimeout) {
+    this->timeout = timeout;
+    this->trainingTimeout = trainingTimeout;
+}
+
+bool N2Coprocessor::setRecovery(bool enable) {
+    if(enable && this->staging)
+        return false;
+
+    if(!enable) {
+        this->notifyRecovery(N2CMU_EVENT_RELEASE);
+        this->recoveryHandler = NULL;
+
+        return true;
+    }
+
+    this->recoveryHandler = N2Coprocessor::handleRecovery;
+    return this->snapshotModel();
+}
+
+bool N2Coprocessor::handleRecovery(N2Coprocessor* self, uint8_t event) {
+    switch(event) {
+        case N2CMU_EVENT_RECOVER:
+            return self->recover();
+
+        case N2CMU_EVENT_SNAPSHOT:
+            return self->snapshotModel();
+
+        case N2CMU_EVENT_RESIZE:
+            self->resizeSnapshot();
+            return true;
+
+        default:
+            for(uint8_t i = 0; i < N2CMU_SNAPSHOT_PARAMS; i++) {
+                free(self->shadow.parameters[i]);
+                self->shadow.parameters[i] = NULL;
+            }
+
+            self->shadow.validMask = 0;
+            return true;
+    }
+}
+
+uint16_t N2Coprocessor::snapshotSize(uint8_t index) {
+    switch(index + N2CMU_PARAM_HIDDEN_WEIGHTS) {
+        case N2CMU_PARAM_HIDDEN_WEIGHTS:
+            return (uint16_t) this->shadow.inputCount *
+                this->shadow.hiddenCount;
+
+        case N2CMU_PARAM_OUTPUT_WEIGHTS:
+            return (uint16_t) this->shadow.hiddenCount *
+                this->shadow.outputCount;
+
+        case N2CMU_PARAM_HIDDEN_BIAS:
+            return this->shadow.hiddenCount;
+
+        default:
+            return this->shadow.outputCount;
+    }
+}
+
+void N2Coprocessor::resizeSnapshot() {
+    this->shadow.validMask = 0;
+
+    for(uint8_t i = 0; i < N2CMU_SNAPSHOT_PARAMS; i++) {
+        free(this->shadow.parameters[i]);
+
+        uint16_t size = this->snapshotSize(i);
+        this->shadow.parameters[i] = size == 0 ? NULL :
+            (float*) malloc(size * sizeof(float));
+    }
+}
+
+bool N2Coprocessor::snapshotModel() {
+    // The get calls would read the staged parameters.
+    if(this->staging || this->recoveryHandler == NULL)
+        return false;
+
+    this->timedOut = false;
+    this->busy = true;
+
+    N2ModelSnapshot snapshot;
+    snapshot.inputCount = this->getInputCount();
+    snapshot.hiddenCount = this->getHiddenCount();
+    snapshot.outputCount = this->getOutputCount();
+    snapshot.epochCount = this->getEpochCount();
+    snapshot.validMask = 0;
+
+    uint16_t sizes[N2CMU_SNAPSHOT_PARAMS] = {
+        (uint16_t) ((uint16_t) snapshot.inputCount * snapshot.hiddenCount),
+        (uint16_t) ((uint16_t) snapshot.hiddenCount * snapshot.outputCount),
+        snapshot.hiddenCount,
+        snapshot.outputCount
+    };
+
+    bool result = !this->timedOut;
+    for(uint8_t i = 0; i < N2CMU_SNAPSHOT_PARAMS; i++) {
+        snapshot.parameters[i] = NULL;
+        if(!result || sizes[i] == 0)
+            continue;
+
+        snapshot.parameters[i] = (float*) malloc(sizes[i] * sizeof(float));
+        result = snapshot.parameters[i] != NULL &&
+            this->transfer(
+                (N2CMUParameter) (i + N2CMU_PARAM_HIDDEN_WEIGHTS),
+                snapshot.parameters[i],
+                false
+            ) && !this->timedOut;
+
+        if(result)
+            snapshot.validMask |= 1 << i;
+    }
+
+    // The previous snapshot stays in place unless every
+    // array of the new one was read completely.
+    N2ModelSnapshot* stale = result ? &this->shadow : &snapshot;
+    for(uint8_t i = 0; i < N2CMU_SNAPSHOT_PARAMS; i++)
+        free(stale->parameters[i]);
+
+    if(result)
+        this->shadow = snapshot;
+
+    this->busy = false;
+    return result;
+}
+
+bool N2Coprocessor::restoreSnapshot() {
+    for(uint8_t i = 0; i < N2CMU_SNAPSHOT_PARAMS; i++)
+        if(this->snapshotSize(i) > 0 &&
+            !(this->shadow.validMask & (1 << i)))
+            return false;
+
+    this->createNetwork(
+        this->shadow.inputCount,
+        this->shadow.hiddenCount,
+        this->shadow.outputCount
+    );
+    this->setEpochCount(this->shadow.epochCount);
+
+    if(this->monitor.interval != 0)
+        this->sendProgressInterval();
+
+    for(uint8_t i = 0; i < N2CMU_SNAPSHOT_PARAMS; i++)
+        if((this->shadow.validMask & (1 << i)) &&
+            !this->transfer(
+                (N2CMUParameter) (i + N2CMU_PARAM_HIDDEN_WEIGHTS),
+                this->shadow.parameters[i],
+                true
+            ))
+            return false;
+
+    if(this->staging) {
+        this->stagingLost = true;
+        if(!this->stageModel(true))
+            return false;
+    }
+
+    return !this->timedOut;
+}
+
+bool N2Coprocessor::recover() {
+    if(this->recovering)
+        return false;
+
+    this->recovering = true;
+    this->timedOut = false;
+    this->flush();
+
+    bool result = this->handshake();
+    if(!result) {
+        this->timedOut = false;
+        this->flush();
+
+        result = this->cpuReset() && this->restoreSnapshot();
+    }
+
+    this->flush();
+    this->recovering = false;
+
+    return result;
+}
+
+bool N2Coprocessor::modelReplaced(bool result) {
+    this->invalidateCache();
+
+    if(!result || this->recoveryHandler == NULL)
+        return result;
+    return this->recoveryHandler(this, N2CMU_EVENT_SNAPSHOT);
+}
+
+bool N2Coprocessor::stageModel(bool enable) {
+    const uint8_t data[] = {N2CMU_MODEL_STAGE, (uint8_t) enable};
+
+    this->writeData(data, 2);
+    return this->getResultStatus();
+}
+
+bool N2Coprocessor::beginModelUpdate() {
+    bool result = this->attempt([&]() -> bool {
+        return this->stageModel(true);
+    });
+
+    this->staging = result;
+    this->stagingLost = false;
+
+    return result;
+}
+
+bool N2Coprocessor::commitModel() {
+    if(!this->staging)
+        return false;
+
+    // Once the commit was sent, a lost status leaves open
+    // whether the device swapped the models, and a second
+    // commit would be refused either way. So it is never
+    // sent twice.
+    bool sent = false;
+    bool result = this->attempt([&]() -> bool {
+        if(sent || this->stagingLost)
+            return false;
+
+        sent = true;
+        this->n2serial->write(N2CMU_MODEL_COMMIT);
+        return this->getResultStatus();
+    });
+
+    // Closing the staging slot brings the device back in
+    // line with the host, with whichever model it has.
+    if(!result) {
+        this->modelReplaced(this->discardModelUpdate());
+        return false;
+    }
+
+    this->staging = false;
+    return this->modelReplaced(true);
+}
+
+bool N2Coprocessor::discardModelUpdate() {
+    bool result = this->attempt([&]() -> bool {
+        return this->stageModel(false);
+    });
+
+    this->staging = false;
+    this->stagingLost = false;
+
+    return result;
+}
+
 bool N2Coprocessor::cpuReset() {
+    if(!this->recovering)
+        this->staging = false;
+
     this->n2serial->write(N2CMU_PROC_CPU_RESET);
+    this->invalidateCache();
     delayMicroseconds(N2CMU_RESET_TIMEOUT);
 
+    this->flush();
     return this->handshake();
 }
 
@@ -114,6 +524,17 @@ void N2Coprocessor::createNetwork(
         };
 
     this->writeData(data, 4);
+    this->invalidateCache();
+
+    if(this->recovering)
+        return;
+
+    this->shadow.inputCount = inputCount;
+    this->shadow.hiddenCount = hiddenCount;
+    this->shadow.outputCount = outputCount;
+    this->notifyRecovery(N2CMU_EVENT_RESIZE);
+
+    this->staging = false;
 }
 
 bool N2Coprocessor::train(
@@ -122,30 +543,463 @@ bool N2Coprocessor::train(
     uint16_t len,
     float learningRate
 ) {
-    if(this->getEpochCount() == 0)
+    if(this->staging)
         return false;
 
-    uint8_t inputCount = this->getInputCount();
-    uint8_t outputCount = this->getOutputCount();
+    bool result = this->attempt([&]() -> bool {
+        if(this->getEpochCount() == 0)
+            return false;
 
-    this->n2serial->write(N2CMU_NET_TRAIN);
-    this->writeU16(len);
+        uint8_t inputCount = this->getInputCount();
+        uint8_t outputCount = this->getOutputCount();
 
-    for(uint8_t j = 0; j < len; j++)
-        for(uint8_t k = 0; k < inputCount; k++)
-            this->writeF32(data[j * inputCount + k]);
+        this->n2serial->write(N2CMU_NET_TRAIN);
+        this->writeDataset(data, output, len, inputCount, outputCount);
 
-    for(uint8_t j = 0; j < len; j++)
-        for(uint8_t k = 0; k < outputCount; k++)
-            this->writeF32(output[j * outputCount + k]);
+        this->writeF32(learningRate);
+        return this->getTrainingStatus();
+    });
 
-    this->writeF32(learningRate);
-    return this->getResultStatus();
+    return this->modelReplaced(result);
+}
+
+bool N2Coprocessor::train(
+    float* data,
+    float* output,
+    uint16_t len,
+    const N2TrainingConfig& config
+) {
+    if(this->staging)
+        return false;
+
+    bool result = this->attempt([&]() -> bool {
+        if(this->getEpochCount() == 0)
+            return false;
+
+        uint8_t inputCount = this->getInputCount();
+        uint8_t outputCount = this->getOutputCount();
+
+        this->n2serial->write(N2CMU_NET_TRAIN_OPTIMIZED);
+        this->writeDataset(data, output, len, inputCount, outputCount);
+
+        this->writeF32(config.learningRate);
+        this->writeF32(config.momentum);
+        this->n2serial->write(config.schedule);
+        this->writeF32(config.decayRate);
+        this->writeU16(config.decayStep);
+        this->writeU16(config.batchSize);
+
+        return this->getTrainingStatus();
+    });
+
+    return this->modelReplaced(result);
+}
+
+void N2Coprocessor::setTrainingProgress(
+    uint16_t interval,
+    N2ProgressCallback callback,
+    void* context
+) {
+    this->monitor.interval = interval;
+    this->monitor.callback = callback;
+    this->monitor.context = context;
+
+    this->sendProgressInterval();
+}
+
+void N2Coprocessor::setEarlyStopping(
+    float lossThreshold,
+    uint16_t patience,
+    float minDelta
+) {
+    this->monitor.lossThreshold = lossThreshold;
+    this->monitor.patience = patience;
+    this->monitor.minDelta = minDelta;
+}
+
+void N2Coprocessor::sendProgressInterval() {
+    this->n2serial->write(N2CMU_SET_PROGRESS_INTERVAL);
+    this->writeU16(this->monitor.interval);
 }
 
 bool N2Coprocessor::infer(float* input, float* output) {
-    uint8_t inputCount = this->getInputCount();
-    uint8_t outputCount = this->getOutputCount();
+    uint8_t inputCount = 0, outputCount = 0;
+    return this->runInference(input, output, inputCount, outputCount);
+}
+
+bool N2Coprocessor::runInference(
+    float* input,
+    float* output,
+    uint8_t& inputCount,
+    uint8_t& outputCount
+) {
+    if(this->cacheHandler != NULL &&
+        this->cacheHandler(this, N2CMU_EVENT_LOOKUP, input, output, 0, 0))
+        return true;
+
+    bool known = outputCount > 0;
+    bool result = this->attempt([&]() -> bool {
+        // A retry follows a recovery, which may have
+        // left the device with a different topology.
+        if(!known) {
+            inputCount = this->getInputCount();
+            outputCount = this->getOutputCount();
+        }
+        known = false;
+
+        return this->inferSample(input, output, inputCount, outputCount);
+    });
+
+    if(!result)
+        outputCount = 0;
+
+    if(result && this->cacheHandler != NULL)
+        this->cacheHandler(
+            this,
+            N2CMU_EVENT_STORE,
+            input,
+            output,
+            inputCount,
+            outputCount
+        );
+
+    return result;
+}
+
+bool N2Coprocessor::setInferenceCache(uint8_t capacity, float quantization) {
+    if(this->cacheHandler != NULL)
+        this->cacheHandler(this, N2CMU_EVENT_RELEASE, NULL, NULL, 0, 0);
+
+    this->cacheHandler = NULL;
+    this->cache.quantization = quantization;
+    this->invalidateCache();
+
+    if(capacity == 0)
+        return true;
+
+    this->cache.keys = (uint32_t*) malloc(capacity * sizeof(uint32_t));
+    this->cache.stamps = (uint32_t*) malloc(capacity * sizeof(uint32_t));
+    this->cache.capacity = capacity;
+    this->cacheHandler = N2Coprocessor::handleCache;
+
+    if(this->cache.keys == NULL || this->cache.stamps == NULL) {
+        this->setInferenceCache(0);
+        return false;
+    }
+
+    return true;
+}
+
+bool N2Coprocessor::handleCache(
+    N2Coprocessor* self,
+    uint8_t event,
+    const float* input,
+    float* output,
+    uint8_t inputCount,
+    uint8_t outputCount
+) {
+    switch(event) {
+        case N2CMU_EVENT_LOOKUP:
+            if(self->cache.outputCount == 0) {
+                self->cache.misses++;
+                return false;
+            }
+
+            return self->cacheLookup(self->cacheKey(input), input, output);
+
+        case N2CMU_EVENT_STORE:
+            if(self->cache.outputCount == 0 &&
+                !self->resizeCache(inputCount, outputCount))
+                return false;
+
+            self->cacheStore(self->cacheKey(input), input, output);
+            return true;
+
+        default:
+            free(self->cache.keys);
+            free(self->cache.stamps);
+            free(self->cache.inputs);
+            free(self->cache.outputs);
+
+            self->cache.keys = NULL;
+            self->cache.stamps = NULL;
+            self->cache.inputs = NULL;
+            self->cache.outputs = NULL;
+            self->cache.capacity = 0;
+
+            return true;
+    }
+}
+
+void N2Coprocessor::clearInferenceCache() {
+    this->invalidateCache();
+
+    this->cache.hits = 0;
+    this->cache.misses = 0;
+}
+
+uint32_t N2Coprocessor::getCacheHits() {
+    return this->cache.hits;
+}
+
+uint32_t N2Coprocessor::getCacheMisses() {
+    return this->cache.misses;
+}
+
+void N2Coprocessor::invalidateCache() {
+    this->cache.count = 0;
+    this->cache.outputCount = 0;
+}
+
+bool N2Coprocessor::resizeCache(uint8_t inputCount, uint8_t outputCount) {
+    if(outputCount == 0)
+        return false;
+
+    float* outputs = (float*) realloc(
+        this->cache.outputs,
+        (size_t) this->cache.capacity * outputCount * sizeof(float)
+    );
+
+    if(outputs == NULL)
+        return false;
+    this->cache.outputs = outputs;
+
+    int32_t* inputs = (int32_t*) realloc(
+        this->cache.inputs,
+        (size_t) this->cache.capacity * inputCount * sizeof(int32_t)
+    );
+
+    if(inputs == NULL && inputCount > 0)
+        return false;
+    this->cache.inputs = inputs;
+
+    this->cache.inputCount = inputCount;
+    this->cache.outputCount = outputCount;
+
+    return true;
+}
+
+int32_t N2Coprocessor::cacheQuantize(float input) {
+    int32_t value;
+
+    if(this->cache.quantization > 0.0f)
+        value = (int32_t) floorf(input / this->cache.quantization + 0.5f);
+    else {
+        float number = input == 0.0f ? 0.0f : input;
+        memcpy(&value, &number, sizeof(value));
+    }
+
+    return value;
+}
+
+uint32_t N2Coprocessor::cacheKey(const float* input) {
+    uint32_t hash = 2166136261UL;
+
+    for(uint8_t i = 0; i < this->cache.inputCount; i++) {
+        int32_t value = this->cacheQuantize(input[i]);
+
+        for(uint8_t j = 0; j < 4; j++) {
+            hash ^= (uint8_t) (value >> (8 * j));
+            hash *= 16777619UL;
+        }
+    }
+
+    return hash;
+}
+
+bool N2Coprocessor::cacheMatches(uint8_t slot, const float* input) {
+    const int32_t* values = this->cache.inputs +
+        slot * this->cache.inputCount;
+
+    for(uint8_t i = 0; i < this->cache.inputCount; i++)
+        if(values[i] != this->cacheQuantize(input[i]))
+            return false;
+
+    return true;
+}
+
+bool N2Coprocessor::cacheLookup(uint32_t key, const float* input, float* output) {
+    for(uint8_t i = 0; i < this->cache.count; i++)
+        if(this->cache.keys[i] == key && this->cacheMatches(i, input)) {
+            memcpy(
+                output,
+                this->cache.outputs + i * this->cache.outputCount,
+                this->cache.outputCount * sizeof(float)
+            );
+
+            this->cache.stamps[i] = ++this->cache.tick;
+            this->cache.hits++;
+
+            return true;
+        }
+
+    this->cache.misses++;
+    return false;
+}
+
+void N2Coprocessor::cacheStore(uint32_t key, const float* input, const float* output) {
+    uint8_t slot = this->cache.count;
+
+    if(slot == this->cache.capacity) {
+        slot = 0;
+
+        for(uint8_t i = 1; i < this->cache.count; i++)
+            if(this->cache.stamps[i] < this->cache.stamps[slot])
+                slot = i;
+    }
+    else this->cache.count++;
+
+    this->cache.keys[slot] = key;
+    this->cache.stamps[slot] = ++this->cache.tick;
+
+    for(uint8_t i = 0; i < this->cache.inputCount; i++)
+        this->cache.inputs[slot * this->cache.inputCount + i] =
+            this->cacheQuantize(input[i]);
+
+    memcpy(
+        this->cache.outputs + slot * this->cache.outputCount,
+        output,
+        this->cache.outputCount * sizeof(float)
+    );
+}
+
+bool N2Coprocessor::inferBatch(float* inputs, float* outputs, uint16_t count) {
+    return this->attempt([&]() -> bool {
+        uint8_t inputCount = this->getInputCount();
+        uint8_t outputCount = this->getOutputCount();
+
+        for(uint16_t i = 0; i < count; i++)
+            if(!this->inferSample(
+                inputs + i * inputCount,
+                outputs + i * outputCount,
+                inputCount,
+                outputCount
+            ))
+                return false;
+
+        return true;
+    });
+}
+
+bool N2Coprocessor::evaluate(
+    float* inputs,
+    float* targets,
+    uint16_t count,
+    N2Evaluation* result,
+    bool confusion
+) {
+    return this->attempt([&]() -> bool {
+        uint8_t inputCount = this->getInputCount();
+        uint8_t outputCount = this->getOutputCount();
+
+        this->n2serial->write(N2CMU_NET_EVALUATE);
+        this->writeDataset(inputs, targets, count, inputCount, outputCount);
+        this->n2serial->write((uint8_t) confusion);
+
+        if(!this->waitFor(8, this->trainingTimeout))
+            return false;
+
+        result->meanSquaredError = this->readF32();
+        result->accuracy = this->readF32();
+
+        if(confusion) {
+            result->truePositives = this->readU16();
+            result->falsePositives = this->readU16();
+            result->trueNegatives = this->readU16();
+            result->falseNegatives = this->readU16();
+        }
+        else result->truePositives = result->falsePositives =
+            result->trueNegatives = result->falseNegatives = 0;
+
+        return this->getResultStatus();
+    });
+}
+
+bool N2Coprocessor::sweep(
+    float* data,
+    float* output,
+    uint16_t len,
+    uint16_t validationCount,
+    const N2SweepConfig* configs,
+    uint8_t configCount,
+    float* scores,
+    uint8_t* best
+) {
+    if(configCount == 0 || validationCount == 0 || validationCount >= len)
+        return false;
+
+    // The device builds fresh networks, which would
+    // close the staging slot behind our back.
+    if(this->staging && !this->discardModelUpdate())
+        return false;
+
+    bool result = this->attempt([&]() -> bool {
+        uint8_t inputCount = this->getInputCount();
+        uint8_t outputCount = this->getOutputCount();
+
+        this->n2serial->write(N2CMU_NET_SWEEP);
+        this->writeDataset(data, output, len, inputCount, outputCount);
+        this->writeU16(validationCount);
+
+        this->n2serial->write(configCount);
+        for(uint8_t i = 0; i < configCount; i++) {
+            this->n2serial->write(configs[i].hiddenCount);
+            this->writeF32(configs[i].learningRate);
+            this->writeU16(configs[i].epochCount);
+        }
+
+        for(uint8_t i = 0; i < configCount; i++) {
+            if(!this->waitFor(4, this->trainingTimeout))
+                return false;
+
+            float score = this->readF32();
+            if(scores != NULL)
+                scores[i] = score;
+        }
+
+        *best = this->readU8();
+        return this->getResultStatus();
+    });
+
+    return this->modelReplaced(result);
+}
+
+uint8_t N2Coprocessor::buildSweepGrid(
+    const uint8_t* hiddenCounts,
+    uint8_t hiddenLen,
+    const float* learningRates,
+    uint8_t rateLen,
+    const uint16_t* epochCounts,
+    uint8_t epochLen,
+    N2SweepConfig* configs
+) {
+    if((uint32_t) hiddenLen * rateLen * epochLen > 255)
+        return 0;
+
+    uint8_t count = 0;
+
+    for(uint8_t h = 0; h < hiddenLen; h++)
+        for(uint8_t r = 0; r < rateLen; r++)
+            for(uint8_t e = 0; e < epochLen; e++) {
+                configs[count].hiddenCount = hiddenCounts[h];
+                configs[count].learningRate = learningRates[r];
+                configs[count].epochCount = epochCounts[e];
+                count++;
+            }
+
+    return count;
+}
+
+bool N2Coprocessor::inferSample(
+    float* input,
+    float* output,
+    uint8_t inputCount,
+    uint8_t outputCount
+) {
+    // A device without a network, such as one whose model
+    // could not be restored after a reset, has nothing to infer.
+    if(outputCount == 0)
+        return false;
 
     this->n2serial->write(N2CMU_NET_INFER);
     for(uint8_t i = 0; i < inputCount; i++)
@@ -159,6 +1013,9 @@ bool N2Coprocessor::infer(float* input, float* output) {
 
 void N2Coprocessor::resetNetwork() {
     this->n2serial->write(N2CMU_NET_RESET);
+    this->invalidateCache();
+
+    this->shadow.validMask = 0;
 }
 
 void N2Coprocessor::setInputCount(uint8_t inputCount) {
@@ -168,6 +1025,11 @@ void N2Coprocessor::setInputCount(uint8_t inputCount) {
     };
 
     this->writeData(data, 2);
+    this->invalidateCache();
+    this->staging = false;
+
+    this->shadow.inputCount = inputCount;
+    this->notifyRecovery(N2CMU_EVENT_RESIZE);
 }
 
 uint8_t N2Coprocessor::getInputCount() {
@@ -182,6 +1044,11 @@ void N2Coprocessor::setHiddenCount(uint8_t hiddenCount) {
     };
 
     this->writeData(data, 2);
+    this->invalidateCache();
+    this->staging = false;
+
+    this->shadow.hiddenCount = hiddenCount;
+    this->notifyRecovery(N2CMU_EVENT_RESIZE);
 }
 
 uint8_t N2Coprocessor::getHiddenCount() {
@@ -196,6 +1063,11 @@ void N2Coprocessor::setOutputCount(uint8_t outputCount) {
     };
 
     this->writeData(data, 2);
+    this->invalidateCache();
+    this->staging = false;
+
+    this->shadow.outputCount = outputCount;
+    this->notifyRecovery(N2CMU_EVENT_RESIZE);
 }
 
 uint8_t N2Coprocessor::getOutputCount() {
@@ -206,6 +1078,8 @@ uint8_t N2Coprocessor::getOutputCount() {
 void N2Coprocessor::setEpochCount(uint16_t epoch) {
     this->n2serial->write(N2CMU_SET_EPOCH_COUNT);
     this->writeU16(epoch);
+
+    this->shadow.epochCount = epoch;
 }
 
 uint16_t N2Coprocessor::getEpochCount() {
@@ -213,150 +1087,254 @@ uint16_t N2Coprocessor::getEpochCount() {
     return this->readU16();
 }
 
-bool N2Coprocessor::setHiddenNeuron(float* hiddenNeuron) {
-    uint8_t hiddenCount = this->getHiddenCount();
-
-    this->n2serial->write(N2CMU_SET_HIDDEN_NEURON);
-    for(uint8_t i = 0; i < hiddenCount; i++)
-        this->writeF32(hiddenNeuron[i]);
-
-    return this->getResultStatus();
-}
-
-void N2Coprocessor::getHiddenNeuron(float* hiddenNeuron) {
-    uint8_t hiddenCount = this->getHiddenCount();
-
-    this->n2serial->write(N2CMU_GET_HIDDEN_NEURON);
-    for(uint8_t i = 0; i < hiddenCount; i++)
-        hiddenNeuron[i] = this->readF32();
-}
+bool N2Coprocessor::getDevicePerf(N2DevicePerf* perf) {
+    return this->attempt([&]() -> bool {
+        this->n2serial->write(N2CMU_GET_PERF);
 
-bool N2Coprocessor::setOutputNeuron(float* outputNeuron) {
-    uint8_t outputCount = this->getOutputCount();
+        perf->inferMicros = this->readU32();
+        perf->epochMicros = this->readU32();
+        perf->trainMicros = this->readU32();
+        perf->rxHighWater = this->readU16();
+        perf->rxOverruns = this->readU16();
 
-    this->n2serial->write(N2CMU_SET_OUTPUT_NEURON);
-    for(uint8_t i = 0; i < outputCount; i++)
-        this->writeF32(outputNeuron[i]);
-
-    return this->getResultStatus();
+        return true;
+    });
 }
 
-void N2Coprocessor::getOutputNeuron(float* outputNeuron) {
-    uint8_t outputCount = this->getOutputCount();
-
-    this->n2serial->write(N2CMU_GET_OUTPUT_NEURON);
-    for(uint8_t i = 0; i < outputCount; i++)
-        outputNeuron[i] = this->readF32();
+/**
+ * @brief Size formulas of the parameter arrays.
+ */
+enum N2TransferShape {
+    N2CMU_SHAPE_HIDDEN = 0x00,        ///< One value per hidden neuron.
+    N2CMU_SHAPE_OUTPUT = 0x01,        ///< One value per output neuron.
+    N2CMU_SHAPE_INPUT_HIDDEN = 0x02,  ///< One value per input and hidden neuron pair.
+    N2CMU_SHAPE_HIDDEN_OUTPUT = 0x03  ///< One value per hidden and output neuron pair.
+};
+
+/**
+ * @brief Transfer descriptor of a parameter array.
+ */
+typedef struct N2TransferDescriptor {
+    uint8_t setCommand;  ///< Command for sending the parameter to N2CMU.
+    uint8_t getCommand;  ///< Command for receiving the parameter from N2CMU.
+    uint8_t shape;       ///< Size formula, see N2TransferShape.
+} N2TransferDescriptor;
+
+/**
+ * @brief Transfer descriptors, indexed by N2CMUParameter.
+ */
+static const N2TransferDescriptor transferTable[] PROGMEM = {
+    {N2CMU_SET_HIDDEN_NEURON, N2CMU_GET_HIDDEN_NEURON, N2CMU_SHAPE_HIDDEN},
+    {N2CMU_SET_OUTPUT_NEURON, N2CMU_GET_OUTPUT_NEURON, N2CMU_SHAPE_OUTPUT},
+    {N2CMU_SET_HIDDEN_WEIGHTS, N2CMU_GET_HIDDEN_WEIGHTS, N2CMU_SHAPE_INPUT_HIDDEN},
+    {N2CMU_SET_OUTPUT_WEIGHTS, N2CMU_GET_OUTPUT_WEIGHTS, N2CMU_SHAPE_HIDDEN_OUTPUT},
+    {N2CMU_SET_HIDDEN_BIAS, N2CMU_GET_HIDDEN_BIAS, N2CMU_SHAPE_HIDDEN},
+    {N2CMU_SET_OUTPUT_BIAS, N2CMU_GET_OUTPUT_BIAS, N2CMU_SHAPE_OUTPUT},
+    {N2CMU_SET_HIDDEN_GRAD, N2CMU_GET_HIDDEN_GRAD, N2CMU_SHAPE_HIDDEN},
+    {N2CMU_SET_OUTPUT_GRAD, N2CMU_GET_OUTPUT_GRAD, N2CMU_SHAPE_OUTPUT}
+};
+
+uint16_t N2Coprocessor::getParameterSize(N2CMUParameter parameter) {
+    switch(pgm_read_byte(&transferTable[parameter].shape)) {
+        case N2CMU_SHAPE_HIDDEN:
+            return this->getHiddenCount();
+
+        case N2CMU_SHAPE_OUTPUT:
+            return this->getOutputCount();
+
+        case N2CMU_SHAPE_INPUT_HIDDEN:
+            return (uint16_t) this->getInputCount() *
+                this->getHiddenCount();
+
+        default:
+            return (uint16_t) this->getHiddenCount() *
+                this->getOutputCount();
+    }
 }
 
-bool N2Coprocessor::setHiddenWeights(float* hiddenWeights) {
-    uint8_t count = this->getInputCount() *
-        this->getHiddenCount();
+bool N2Coprocessor::transfer(
+    N2CMUParameter parameter,
+    float* values,
+    bool write
+) {
+    uint16_t count = this->getParameterSize(parameter);
 
-    this->n2serial->write(N2CMU_SET_HIDDEN_WEIGHTS);
-    for(uint8_t i = 0; i < count; i++)
-        this->writeF32(hiddenWeights[i]);
+    if(write) {
+        this->n2serial->write(pgm_read_byte(&transferTable[parameter].setCommand));
+        for(uint16_t i = 0; i < count; i++)
+            this->writeF32(values[i]);
 
-    return this->getResultStatus();
-}
+        return this->getResultStatus();
+    }
 
-void N2Coprocessor::getHiddenWeights(float* hiddenWeights) {
-    uint8_t count = this->getInputCount() *
-        this->getHiddenCount();
+    this->n2serial->write(pgm_read_byte(&transferTable[parameter].getCommand));
+    for(uint16_t i = 0; i < count; i++)
+        values[i] = this->readF32();
 
-    this->n2serial->write(N2CMU_GET_HIDDEN_WEIGHTS);
-    for(uint8_t i = 0; i < count; i++)
-        hiddenWeights[i] = this->readF32();
+    return true;
 }
 
-bool N2Coprocessor::setOutputWeights(float* outputWeights) {
-    uint8_t count = this->getHiddenCount() *
-        this->getOutputCount();
-
-    this->n2serial->write(N2CMU_SET_OUTPUT_WEIGHTS);
-    for(uint8_t i = 0; i < count; i++)
-        this->writeF32(outputWeights[i]);
-
-    return this->getResultStatus();
+bool N2Coprocessor::transfer(
+    N2CMUParameter parameter,
+    N2ParameterCallback callback,
+    void* context,
+    bool write
+) {
+    uint16_t count = this->getParameterSize(parameter);
+    float value;
+
+    if(write) {
+        this->n2serial->write(pgm_read_byte(&transferTable[parameter].setCommand));
+        for(uint16_t i = 0; i < count; i++) {
+            callback(i, &value, context);
+            this->writeF32(value);
+        }
+
+        return this->getResultStatus();
+    }
+
+    this->n2serial->write(pgm_read_byte(&transferTable[parameter].getCommand));
+    for(uint16_t i = 0; i < count; i++) {
+        value = this->readF32();
+        callback(i, &value, context);
+    }
+
+    return true;
 }
 
-void N2Coprocessor::getOutputWeights(float* outputWeights) {
-    uint8_t count = this->getHiddenCount() *
-        this->getOutputCount();
-
-    this->n2serial->write(N2CMU_GET_OUTPUT_WEIGHTS);
-    for(uint8_t i = 0; i < count; i++)
-        outputWeights[i] = this->readF32();
+bool N2Coprocessor::setParameter(N2CMUParameter parameter, float* values) {
+    bool result = this->attempt([&]() -> bool {
+        return this->transfer(parameter, values, true);
+    });
+
+    if(this->staging)
+        return result;
+    this->invalidateCache();
+
+    uint8_t index = parameter - N2CMU_PARAM_HIDDEN_WEIGHTS;
+    if(result && !this->recovering &&
+        index < N2CMU_SNAPSHOT_PARAMS &&
+        this->shadow.parameters[index] != NULL) {
+        memcpy(
+            this->shadow.parameters[index],
+            values,
+            this->snapshotSize(index) * sizeof(float)
+        );
+
+        this->shadow.validMask |= 1 << index;
+    }
+
+    return result;
 }
 
-bool N2Coprocessor::setHiddenBias(float* hiddenBias) {
-    uint8_t hiddenCount = this->getHiddenCount();
-
-    this->n2serial->write(N2CMU_SET_HIDDEN_BIAS);
-    for(uint8_t i = 0; i < hiddenCount; i++)
-        this->writeF32(hiddenBias[i]);
-
-    return this->getResultStatus();
+bool N2Coprocessor::getParameter(N2CMUParameter parameter, float* values) {
+    return this->attempt([&]() -> bool {
+        return this->transfer(parameter, values, false);
+    });
 }
 
-void N2Coprocessor::getHiddenBias(float* hiddenBias) {
-    uint8_t hiddenCount = this->getHiddenCount();
-
-    this->n2serial->write(N2CMU_GET_HIDDEN_BIAS);
-    for(uint8_t i = 0; i < hiddenCount; i++)
-        hiddenBias[i] = this->readF32();
+/**
+ * @brief Context of a streamed set which keeps the snapshot in step.
+ */
+typedef struct N2ShadowStream {
+    N2ParameterCallback callback;  ///< Callback supplying the values.
+    void* context;                 ///< User pointer of the callback.
+    float* shadow;                 ///< Snapshot copy of the parameter array.
+    uint16_t size;                 ///< Number of values in the snapshot copy.
+} N2ShadowStream;
+
+static void shadowValue(uint16_t index, float* value, void* context) {
+    N2ShadowStream* stream = (N2ShadowStream*) context;
+
+    stream->callback(index, value, stream->context);
+    if(index < stream->size)
+        stream->shadow[index] = *value;
 }
 
-bool N2Coprocessor::setOutputBias(float* outputBias) {
-    uint8_t outputCount = this->getOutputCount();
-
-    this->n2serial->write(N2CMU_SET_OUTPUT_BIAS);
-    for(uint8_t i = 0; i < outputCount; i++)
-        this->writeF32(outputBias[i]);
-
-    return this->getResultStatus();
+bool N2Coprocessor::setParameter(
+    N2CMUParameter parameter,
+    N2ParameterCallback callback,
+    void* context
+) {
+    uint8_t index = parameter - N2CMU_PARAM_HIDDEN_WEIGHTS;
+    N2ShadowStream stream = {callback, context, NULL, 0};
+
+    // The values pass through RAM only once, so the snapshot
+    // copy is updated while they are sent.
+    if(!this->staging && !this->recovering &&
+        index < N2CMU_SNAPSHOT_PARAMS &&
+        this->shadow.parameters[index] != NULL) {
+        stream.shadow = this->shadow.parameters[index];
+        stream.size = this->snapshotSize(index);
+
+        callback = shadowValue;
+        context = &stream;
+    }
+
+    bool result = this->attempt([&]() -> bool {
+        return this->transfer(parameter, callback, context, true);
+    });
+
+    if(this->staging)
+        return result;
+    this->invalidateCache();
+
+    if(stream.shadow != NULL) {
+        if(result)
+            this->shadow.validMask |= 1 << index;
+        else this->shadow.validMask &= ~(1 << index);
+    }
+
+    return result;
 }
 
-void N2Coprocessor::getOutputBias(float* outputBias) {
-    uint8_t outputCount = this->getOutputCount();
-
-    this->n2serial->write(N2CMU_GET_OUTPUT_BIAS);
-    for(uint8_t i = 0; i < outputCount; i++)
-        outputBias[i] = this->readF32();
+bool N2Coprocessor::getParameter(
+    N2CMUParameter parameter,
+    N2ParameterCallback callback,
+    void* context
+) {
+    return this->attempt([&]() -> bool {
+        return this->transfer(parameter, callback, context, false);
+    });
 }
 
-bool N2Coprocessor::setHiddenGradient(float* hiddenGrad) {
-    uint8_t hiddenCount = this->getHiddenCount();
+bool N2Coprocessor::loadFromProgmem(const N2ProgmemModel* model) {
+    N2ProgmemModel header;
+    memcpy_P(&header, model, sizeof(N2ProgmemModel));
+
+    bool result = this->attempt([&]() -> bool {
+        this->createNetwork(
+            header.inputCount,
+            header.hiddenCount,
+            header.outputCount
+        );
+        this->setEpochCount(header.epochCount);
+
+        uint16_t sizes[N2CMU_SNAPSHOT_PARAMS] = {
+            (uint16_t) ((uint16_t) header.inputCount * header.hiddenCount),
+            (uint16_t) ((uint16_t) header.hiddenCount * header.outputCount),
+            header.hiddenCount,
+            header.outputCount
+        };
 
-    this->n2serial->write(N2CMU_SET_HIDDEN_GRAD);
-    for(uint8_t i = 0; i < hiddenCount; i++)
-        this->writeF32(hiddenGrad[i]);
+        for(uint8_t i = 0; i < N2CMU_SNAPSHOT_PARAMS; i++) {
+            const float* values = header.parameters[i];
+            if(values == NULL)
+                continue;
 
-    return this->getResultStatus();
-}
+            this->n2serial->write(pgm_read_byte(
+                &transferTable[i + N2CMU_PARAM_HIDDEN_WEIGHTS].setCommand
+            ));
 
-void N2Coprocessor::getHiddenGradient(float* hiddenGrad) {
-    uint8_t hiddenCount = this->getHiddenCount();
+            for(uint16_t j = 0; j < sizes[i]; j++)
+                this->writeF32(pgm_read_float(values + j));
 
-    this->n2serial->write(N2CMU_GET_HIDDEN_GRAD);
-    for(uint8_t i = 0; i < hiddenCount; i++)
-        hiddenGrad[i] = this->readF32();
-}
+            if(!this->getResultStatus())
+                return false;
+        }
 
-bool N2Coprocessor::setOutputGradient(float* outputGrad) {
-    uint8_t outputCount = this->getOutputCount();
+        return true;
+    });
 
-    this->n2serial->write(N2CMU_SET_OUTPUT_GRAD);
-    for(uint8_t i = 0; i < outputCount; i++)
-        this->writeF32(outputGrad[i]);
-
-    return this->getResultStatus();
+    return this->modelReplaced(result);
 }
-
-void N2Coprocessor::getOutputGradient(float* outputGrad) {
-    uint8_t outputCount = this->getOutputCount();
-
-    this->n2serial->write(N2CMU_GET_OUTPUT_GRAD);
-    for(uint8_t i = 0; i < outputCount; i++)
-        outputGrad[i] = this->readF32();
-}
\ No newline at end of file
@@ -25,15 +25,244 @@
  * initializing, configuring, training, and inferring with neural networks,
  * as well as setting and getting various parameters of the neural network
  * model.
+ *
+ * Automatic recovery and the inference cache are reached only through
+ * handlers installed by setRecovery() and setInferenceCache(), so the
+ * linker drops their code from sketches which never enable them. The
+ * rarely needed accessors can be left out with N2CMU_NO_NEURON_ACCESSORS
+ * and N2CMU_NO_GRADIENT_ACCESSORS.
  */
 #ifndef N2CMU_H
 #define N2CMU_H
 
+#ifdef ARDUINO
 #include <SoftwareSerial.h>
 
+typedef SoftwareSerial N2Serial; ///< Serial transport used to communicate with N2CMU.
+#else
+#include "n2cmu_posix.h"
+
+typedef N2PosixSerial N2Serial; ///< Serial transport used to communicate with N2CMU.
+#endif
+
 #define N2CMU_RX_PIN 6 ///< Pin number for receiving data from N2CMU.
 #define N2CMU_TX_PIN 5 ///< Pin number for transmitting data to N2CMU.
 #define N2CMU_RESET_TIMEOUT 4558 ///< Timeout duration for resetting N2CMU device.
+#define N2CMU_BAUD_RATE 31250 ///< Baud rate of the serial link to N2CMU.
+#define N2CMU_RESPONSE_TIMEOUT 1000 ///< Default time in milliseconds to wait for a response from N2CMU.
+#define N2CMU_PROGRESS_FRAME 0x02 ///< Marker byte of a training progress frame sent by N2CMU.
+
+class N2SharedCoprocessor;
+
+/**
+ * @brief Learning rate schedules supported by the N2CMU optimizer.
+ */
+typedef enum N2CMULearningRateSchedule {
+    N2CMU_LR_CONSTANT = 0x00,    ///< Learning rate stays the same for all epochs.
+    N2CMU_LR_STEP = 0x01,        ///< Learning rate is multiplied by the decay rate every decay step epochs.
+    N2CMU_LR_EXPONENTIAL = 0x02  ///< Learning rate decays as rate * decayRate^(epoch / decayStep).
+} N2CMULearningRateSchedule;
+
+/**
+ * @brief Optimizer configuration for training.
+ * 
+ * The N2TrainingConfig structure describes how the N2CMU
+ * device updates the network parameters during training.
+ * Momentum and a decaying learning rate usually reach the
+ * same accuracy as plain SGD in far fewer epochs.
+ */
+typedef struct N2TrainingConfig {
+    float learningRate;  ///< Initial learning rate.
+    float momentum;      ///< Momentum coefficient, 0 for plain SGD.
+    uint8_t schedule;    ///< Learning rate schedule, see N2CMULearningRateSchedule.
+    float decayRate;     ///< Decay factor applied by the schedule.
+    uint16_t decayStep;  ///< Number of epochs per decay step.
+    uint16_t batchSize;  ///< Number of samples per update, 0 or 1 for per-sample updates.
+} N2TrainingConfig;
+
+/**
+ * @brief Parameter arrays of the neural network on N2CMU.
+ * 
+ * Each parameter is transferred with one generic routine
+ * driven by a descriptor table, which holds its commands
+ * and how its size follows from the network topology.
+ */
+typedef enum N2CMUParameter {
+    N2CMU_PARAM_HIDDEN_NEURON = 0x00,  ///< Hidden neuron values (hidden).
+    N2CMU_PARAM_OUTPUT_NEURON = 0x01,  ///< Output neuron values (output).
+    N2CMU_PARAM_HIDDEN_WEIGHTS = 0x02, ///< Input to hidden weights (input * hidden).
+    N2CMU_PARAM_OUTPUT_WEIGHTS = 0x03, ///< Hidden to output weights (hidden * output).
+    N2CMU_PARAM_HIDDEN_BIAS = 0x04,    ///< Hidden neuron biases (hidden).
+    N2CMU_PARAM_OUTPUT_BIAS = 0x05,    ///< Output neuron biases (output).
+    N2CMU_PARAM_HIDDEN_GRAD = 0x06,    ///< Hidden neuron gradients (hidden).
+    N2CMU_PARAM_OUTPUT_GRAD = 0x07     ///< Output neuron gradients (output).
+} N2CMUParameter;
+
+/**
+ * @brief Aggregate metrics of an on-device evaluation.
+ * 
+ * Accuracy counts a sample as correct when its output
+ * class matches the target class: the output above 0.5
+ * for single-output networks, the largest output for
+ * networks with several outputs. The confusion summary
+ * thresholds every output at 0.5 and is only filled in
+ * when requested.
+ */
+typedef struct N2Evaluation {
+    float meanSquaredError;   ///< Mean squared error over all samples and outputs.
+    float accuracy;           ///< Fraction of correctly classified samples, from 0 to 1.
+    uint16_t truePositives;   ///< Outputs above 0.5 with a target above 0.5.
+    uint16_t falsePositives;  ///< Outputs above 0.5 with a target of 0.5 or below.
+    uint16_t trueNegatives;   ///< Outputs of 0.5 or below with a target of 0.5 or below.
+    uint16_t falseNegatives;  ///< Outputs of 0.5 or below with a target above 0.5.
+} N2Evaluation;
+
+/**
+ * @brief Performance counters measured by the N2CMU device.
+ * 
+ * The timings only cover computation on the device, so
+ * comparing them with host-side timings separates the
+ * serial link cost from the compute cost. The receive
+ * buffer counters show whether the link is driven faster
+ * than the device can take the data in.
+ */
+typedef struct N2DevicePerf {
+    uint32_t inferMicros;     ///< Duration of the last forward pass in microseconds.
+    uint32_t epochMicros;     ///< Duration of the last training epoch in microseconds.
+    uint32_t trainMicros;     ///< Duration of the last training run in microseconds.
+    uint16_t rxHighWater;     ///< Highest number of bytes held in the device receive buffer.
+    uint16_t rxOverruns;      ///< Number of received bytes dropped on a full receive buffer.
+} N2DevicePerf;
+
+/**
+ * @brief One candidate configuration of a hyperparameter sweep.
+ */
+typedef struct N2SweepConfig {
+    uint8_t hiddenCount;   ///< Number of hidden neurons.
+    float learningRate;    ///< Learning rate for training.
+    uint16_t epochCount;   ///< Epoch count for training.
+} N2SweepConfig;
+
+/**
+ * @brief Number of parameter arrays kept in the recovery snapshot.
+ * 
+ * The snapshot holds the hidden and output weights and biases,
+ * which are the consecutive parameters starting at
+ * N2CMU_PARAM_HIDDEN_WEIGHTS.
+ */
+#define N2CMU_SNAPSHOT_PARAMS 4
+
+/**
+ * @brief Host-side shadow copy of the model on N2CMU.
+ * 
+ * The N2ModelSnapshot structure holds everything needed
+ * to rebuild the model after a CPU reset of the device:
+ * the topology, the epoch count, and the weights and
+ * biases of both layers.
+ */
+typedef struct N2ModelSnapshot {
+    uint8_t inputCount;                         ///< Number of input neurons.
+    uint8_t hiddenCount;                        ///< Number of hidden neurons.
+    uint8_t outputCount;                        ///< Number of output neurons.
+    uint16_t epochCount;                        ///< Epoch count for training.
+    uint8_t validMask;                          ///< Bit set for every parameter array holding current values.
+    float* parameters[N2CMU_SNAPSHOT_PARAMS];   ///< Weights and biases, indexed from N2CMU_PARAM_HIDDEN_WEIGHTS.
+} N2ModelSnapshot;
+
+/**
+ * @brief Events passed to the recovery and inference cache handlers.
+ */
+typedef enum N2CMUHandlerEvent {
+    N2CMU_EVENT_RECOVER = 0x00,   ///< Recover the device after a timeout.
+    N2CMU_EVENT_SNAPSHOT = 0x01,  ///< Take a new snapshot of the model.
+    N2CMU_EVENT_RESIZE = 0x02,    ///< Resize the snapshot for a new topology.
+    N2CMU_EVENT_LOOKUP = 0x03,    ///< Look up an inference result.
+    N2CMU_EVENT_STORE = 0x04,     ///< Store an inference result.
+    N2CMU_EVENT_RELEASE = 0x05    ///< Release all memory of the feature.
+} N2CMUHandlerEvent;
+
+/**
+ * @brief Training progress callback.
+ * 
+ * Called on every progress frame sent by the N2CMU device
+ * during training. Returning false stops training early.
+ * 
+ * @param epoch Number of epochs completed so far.
+ * @param loss Mean squared error over the training set in the last epoch.
+ * @param context User pointer given to setTrainingProgress().
+ * @return True to continue training, false to stop it.
+ */
+typedef bool (*N2ProgressCallback)(uint16_t epoch, float loss, void* context);
+
+/**
+ * @brief Parameter streaming callback.
+ * 
+ * Called once for every value of a parameter array, in
+ * order, so the array never has to be held in RAM. A get
+ * passes every value received from the N2CMU device, a set
+ * asks for every value before sending it. After a timeout
+ * the transfer may start over from index 0.
+ * 
+ * @param index Index of the value in the parameter array.
+ * @param value Pointer to the value received, or to store the value to send.
+ * @param context User pointer given along with the callback.
+ */
+typedef void (*N2ParameterCallback)(uint16_t index, float* value, void* context);
+
+/**
+ * @brief Training progress and early stopping settings.
+ */
+typedef struct N2TrainingMonitor {
+    uint16_t interval;            ///< Number of epochs between progress frames, 0 to disable them.
+    N2ProgressCallback callback;  ///< Progress callback, may be NULL.
+    void* context;                ///< User pointer passed to the callback.
+    float lossThreshold;          ///< Training stops once the loss is below this value, 0 to disable.
+    uint16_t patience;            ///< Training stops after this many frames without improvement, 0 to disable.
+    float minDelta;               ///< Smallest loss decrease counted as an improvement.
+} N2TrainingMonitor;
+
+/**
+ * @brief Host-side LRU cache of inference results.
+ * 
+ * The N2InferenceCache structure maps the (optionally
+ * quantized) input vector to the output vector the
+ * device returned for it. Entries are found by a hash
+ * of the input and confirmed by comparing the stored
+ * input itself. They are evicted least recently used
+ * first.
+ */
+typedef struct N2InferenceCache {
+    uint8_t capacity;     ///< Maximum number of entries, 0 if the cache is disabled.
+    uint8_t count;        ///< Number of valid entries.
+    uint8_t inputCount;   ///< Number of input neurons the entries were made for.
+    uint8_t outputCount;  ///< Number of output neurons the entries were made for, 0 if not known yet.
+    float quantization;   ///< Quantization step of the inputs, 0 to hash exact values.
+    uint32_t tick;        ///< Use counter for least recently used eviction.
+    uint32_t hits;        ///< Number of inferences answered from the cache.
+    uint32_t misses;      ///< Number of inferences sent to the device.
+    uint32_t* keys;       ///< Input hash of every entry.
+    uint32_t* stamps;     ///< Last use of every entry.
+    int32_t* inputs;      ///< Quantized input vector of every entry.
+    float* outputs;       ///< Output vector of every entry.
+} N2InferenceCache;
+
+/**
+ * @brief Pretrained model stored in program memory.
+ * 
+ * The N2ProgmemModel structure describes a model whose
+ * parameter arrays live in flash, declared with PROGMEM.
+ * It is usually generated from a saved model with
+ * extras/tools/n2cmu_model2header.py. The structure
+ * itself must be declared with PROGMEM as well, since
+ * loadFromProgmem() reads it from flash.
+ */
+typedef struct N2ProgmemModel {
+    uint8_t inputCount;                               ///< Number of input neurons.
+    uint8_t hiddenCount;                              ///< Number of hidden neurons.
+    uint8_t outputCount;                              ///< Number of output neurons.
+    uint16_t epochCount;                              ///< Epoch count for training.
+    const float* parameters[N2CMU_SNAPSHOT_PARAMS];   ///< Weights and biases in PROGMEM, indexed from N2CMU_PARAM_HIDDEN_WEIGHTS.
+} N2ProgmemModel;
 
 /**
  * @class N2Coprocessor
@@ -46,7 +275,252 @@
  */
 class N2Coprocessor {
 private:
-    SoftwareSerial *n2serial; ///< Pointer to SoftwareSerial object for serial communication with N2CMU.
+    N2Serial *n2serial; ///< Pointer to the serial transport object for communication with N2CMU.
+
+    unsigned long timeout;          ///< Time in milliseconds to wait for a response, 0 to wait forever.
+    unsigned long trainingTimeout;  ///< Time in milliseconds to wait for training or evaluation, 0 to wait forever.
+    bool timedOut;                  ///< Set when a wait for a response timed out.
+    bool busy;                      ///< True while an operation runs, whose waits end at its first timeout.
+    bool staging;                   ///< True while parameters are written to the staging slot.
+    bool stagingLost;               ///< True if the staging slot was lost to a CPU reset.
+    N2TrainingMonitor monitor;      ///< Training progress and early stopping settings.
+
+    bool recovering;                ///< True while a recovery is in progress.
+    N2ModelSnapshot shadow;         ///< Shadow copy of the model for recovery.
+    N2InferenceCache cache;         ///< Cache of inference results.
+
+    /**
+     * @brief Handler of the recovery events, NULL while recovery is disabled.
+     * 
+     * The recovery code is only referred to by setRecovery(),
+     * which installs handleRecovery() here.
+     */
+    bool (*recoveryHandler)(N2Coprocessor* self, uint8_t event);
+
+    /**
+     * @brief Handler of the inference cache events, NULL while the cache is disabled.
+     * 
+     * The cache code is only referred to by setInferenceCache(),
+     * which installs handleCache() here.
+     */
+    bool (*cacheHandler)(
+        N2Coprocessor* self,
+        uint8_t event,
+        const float* input,
+        float* output,
+        uint8_t inputCount,
+        uint8_t outputCount
+    );
+
+    /**
+     * @brief Initialize the timeout and recovery state.
+     */
+    void initialize();
+
+    /**
+     * @brief Wait until enough bytes were received from N2CMU.
+     * 
+     * Sets the timed out flag and discards the partial
+     * response if the bytes did not arrive within the
+     * given time. Within an operation, every wait after
+     * a timeout fails at once, so a stalled operation
+     * costs a single timeout however long its response.
+     * 
+     * @param count Number of bytes to wait for.
+     * @param wait Time in milliseconds to wait, 0 to wait forever.
+     * @return True if the bytes are available, false on timeout.
+     */
+    bool waitFor(uint8_t count, unsigned long wait);
+
+    /**
+     * @brief Discard all bytes received from N2CMU.
+     */
+    void flush();
+
+    /**
+     * @brief Open or discard the staging slot on the N2CMU device.
+     * @param enable True to open the staging slot, false to discard it.
+     * @return True if the device accepted the command, false otherwise.
+     */
+    bool stageModel(bool enable);
+
+    /**
+     * @brief Bring the host-side state in line with a replaced model.
+     * 
+     * Called after training, sweeps, loading a model from
+     * flash and committing a model update. The inference
+     * cache is emptied and, with recovery enabled, a new
+     * snapshot is taken.
+     * 
+     * @param result Status of the operation which replaced the model.
+     * @return True if the operation and the snapshot succeeded, false otherwise.
+     */
+    bool modelReplaced(bool result);
+
+    /**
+     * @brief Pass an event to the recovery handler.
+     * @param event The event, see N2CMUHandlerEvent.
+     * @return True if recovery is enabled and handled the event, false otherwise.
+     */
+    bool notifyRecovery(uint8_t event) {
+        return this->recoveryHandler != NULL &&
+            this->recoveryHandler(this, event);
+    }
+
+    /**
+     * @brief Handle a recovery event.
+     * @param self The coprocessor.
+     * @param event N2CMU_EVENT_RECOVER, N2CMU_EVENT_SNAPSHOT, N2CMU_EVENT_RESIZE or N2CMU_EVENT_RELEASE.
+     * @return True if the event was handled successfully, false otherwise.
+     */
+    static bool handleRecovery(N2Coprocessor* self, uint8_t event);
+
+    /**
+     * @brief Recover an unresponsive N2CMU device.
+     * 
+     * If the device still answers a handshake, only the
+     * receive buffer is flushed. Otherwise its CPU is reset
+     * and the model is restored from the shadow snapshot.
+     * 
+     * @return True if the device is responsive again, false otherwise.
+     */
+    bool recover();
+
+    /**
+     * @brief Restore the model on N2CMU from the shadow snapshot.
+     * 
+     * If a model update was in progress, the staging slot
+     * is opened again so that the rest of the update cannot
+     * reach the active model, and the update is marked as
+     * lost.
+     * 
+     * @return True if the model was restored, false otherwise.
+     */
+    bool restoreSnapshot();
+
+    /**
+     * @brief Resize the shadow snapshot for its current topology.
+     * 
+     * All parameter arrays are marked as not holding
+     * current values.
+     */
+    void resizeSnapshot();
+
+    /**
+     * @brief Get the size of a parameter array of the shadow snapshot.
+     * @param index Index of the parameter array in the snapshot.
+     * @return Number of float values in the array.
+     */
+    uint16_t snapshotSize(uint8_t index);
+
+    /**
+     * @brief Handle an inference cache event.
+     * @param self The coprocessor.
+     * @param event N2CMU_EVENT_LOOKUP, N2CMU_EVENT_STORE or N2CMU_EVENT_RELEASE.
+     * @param input Pointer to the input data array.
+     * @param output Pointer to the output data array, filled by a lookup.
+     * @param inputCount Number of input neurons of a stored result.
+     * @param outputCount Number of output neurons of a stored result.
+     * @return True if a lookup hit or the event was handled, false otherwise.
+     */
+    static bool handleCache(
+        N2Coprocessor* self,
+        uint8_t event,
+        const float* input,
+        float* output,
+        uint8_t inputCount,
+        uint8_t outputCount
+    );
+
+    /**
+     * @brief Drop all entries of the inference cache.
+     * 
+     * Called by every function which changes the model
+     * or the topology on the N2CMU device.
+     */
+    void invalidateCache();
+
+    /**
+     * @brief Size the inference cache for the network topology.
+     * @param inputCount Number of input neurons.
+     * @param outputCount Number of output neurons.
+     * @return True if the cache was sized, false otherwise.
+     */
+    bool resizeCache(uint8_t inputCount, uint8_t outputCount);
+
+    /**
+     * @brief Quantize one input value for the inference cache.
+     * 
+     * Without a quantization step, the bit pattern of the
+     * value is used, with negative zero folded into zero.
+     * 
+     * @param input The input value.
+     * @return The quantized value.
+     */
+    int32_t cacheQuantize(float input);
+
+    /**
+     * @brief Hash an input vector into an inference cache key.
+     * @param input Pointer to the input data array.
+     * @return The cache key.
+     */
+    uint32_t cacheKey(const float* input);
+
+    /**
+     * @brief Check whether a cache entry was made for an input vector.
+     * @param slot Index of the cache entry.
+     * @param input Pointer to the input data array.
+     * @return True if the quantized inputs are equal, false otherwise.
+     */
+    bool cacheMatches(uint8_t slot, const float* input);
+
+    /**
+     * @brief Look up an inference result in the cache.
+     * @param key The cache key of the input vector.
+     * @param input Pointer to the input data array.
+     * @param output Pointer to store the cached output data array.
+     * @return True if the result was cached, false otherwise.
+     */
+    bool cacheLookup(uint32_t key, const float* input, float* output);
+
+    /**
+     * @brief Store an inference result in the cache.
+     * 
+     * Evicts the least recently used entry when the cache is full.
+     * 
+     * @param key The cache key of the input vector.
+     * @param input Pointer to the input data array.
+     * @param output Pointer to the output data array.
+     */
+    void cacheStore(uint32_t key, const float* input, const float* output);
+
+    /**
+     * @brief Run an operation, recovering and retrying once if it timed out.
+     * 
+     * Without recovery, a timed out operation just fails
+     * and the late bytes of its response are discarded.
+     * 
+     * @param operation Callable performing the operation and returning its status.
+     * @return True if the operation was successful, false otherwise.
+     */
+    template<typename Operation>
+    bool attempt(Operation operation) {
+        // Bytes of a response that arrived after an earlier
+        // timeout would otherwise be read as this one's.
+        if(this->timedOut)
+            this->flush();
+        this->timedOut = false;
+        this->busy = true;
+
+        bool result = operation();
+        if(this->timedOut && this->notifyRecovery(N2CMU_EVENT_RECOVER)) {
+            this->timedOut = false;
+            result = operation();
+        }
+
+        this->busy = false;
+        return result && !this->timedOut;
+    }
 
     /**
      * @brief Checks the result status of the last operation.
@@ -59,6 +533,24 @@ private:
      */
     bool getResultStatus();
 
+    /**
+     * @brief Wait for the result of a training run.
+     * 
+     * Handles the progress frames the N2CMU device sends
+     * while training, passing them to the progress callback
+     * and the early stopping rules, and answers every frame
+     * with whether training should continue. The training
+     * timeout applies to the wait for every single frame.
+     * 
+     * @return True if training was successful, false otherwise.
+     */
+    bool getTrainingStatus();
+
+    /**
+     * @brief Send the progress interval to the N2CMU device.
+     */
+    void sendProgressInterval();
+
     /**
      * @brief Send a command to the N2CMU device.
      * @param command The command to send.
@@ -84,6 +576,12 @@ private:
      */
     uint16_t readU16();
 
+    /**
+     * @brief Read a 32-bit unsigned integer from N2CMU.
+     * @return The read unsigned integer.
+     */
+    uint32_t readU32();
+
     /**
      * @brief Write a 32-bit floating point number to N2CMU.
      * @param data The floating point number to write.
@@ -103,6 +601,97 @@ private:
      */
     void writeData(const uint8_t *data, uint8_t length);
 
+    /**
+     * @brief Write a training data set to N2CMU.
+     * @param data Pointer to the input data array.
+     * @param output Pointer to the output data array.
+     * @param len Number of samples in the data arrays.
+     * @param inputCount Number of input neurons.
+     * @param outputCount Number of output neurons.
+     */
+    void writeDataset(
+        float* data,
+        float* output,
+        uint16_t len,
+        uint8_t inputCount,
+        uint8_t outputCount
+    );
+
+    /**
+     * @brief Run a single inference with already known layer sizes.
+     * 
+     * This is the wire-level part of infer(), without the
+     * input and output count queries. It lets callers that
+     * issue several inferences back to back query the
+     * topology only once.
+     * 
+     * @param input Pointer to the input data array.
+     * @param output Pointer to store the output data array.
+     * @param inputCount Number of input neurons.
+     * @param outputCount Number of output neurons.
+     * @return True if inference was successful, false otherwise.
+     */
+    bool inferSample(
+        float* input,
+        float* output,
+        uint8_t inputCount,
+        uint8_t outputCount
+    );
+
+    /**
+     * @brief Run a single inference through the cache, recovering on timeout.
+     * 
+     * This is infer() for callers which keep the layer
+     * sizes across several inferences. The sizes are
+     * queried when the output count is 0, and again when
+     * the inference is retried after a recovery. They are
+     * reset to 0 if the inference failed.
+     * 
+     * @param input Pointer to the input data array.
+     * @param output Pointer to store the output data array.
+     * @param inputCount Number of input neurons, updated if queried.
+     * @param outputCount Number of output neurons, 0 if not known yet.
+     * @return True if inference was successful, false otherwise.
+     */
+    bool runInference(
+        float* input,
+        float* output,
+        uint8_t& inputCount,
+        uint8_t& outputCount
+    );
+
+    /**
+     * @brief Transfer a parameter array to or from N2CMU.
+     * 
+     * This is the single routine behind all parameter
+     * accessors. The command and the array size are
+     * looked up in the descriptor table.
+     * 
+     * @param parameter The parameter to transfer.
+     * @param values Array to send or to store the received values.
+     * @param write True to send the values, false to receive them.
+     * @return True if the transfer was successful, false otherwise.
+     */
+    bool transfer(N2CMUParameter parameter, float* values, bool write);
+
+    /**
+     * @brief Stream a parameter array to or from N2CMU.
+     * 
+     * @param parameter The parameter to transfer.
+     * @param callback Callback receiving or supplying every value.
+     * @param context User pointer passed to the callback.
+     * @param write True to send the values, false to receive them.
+     * @return True if the transfer was successful, false otherwise.
+     */
+    bool transfer(
+        N2CMUParameter parameter,
+        N2ParameterCallback callback,
+        void* context,
+        bool write
+    );
+
+    friend class N2SharedCoprocessor;
+
 public:
     /**
      * @brief Constructor for N2Coprocessor class.
@@ -110,13 +699,43 @@ public:
      * Constructs a new N2Coprocessor object with
      * the specified RX and TX pins for serial communication.
      * 
+     * On non-Arduino hosts, the constructor instead takes
+     * the path and baud rate of the serial device, such as
+     * a USB-UART adapter wired to the N2CMU.
+     * 
      * @param rx Pin number for receiving data from N2CMU.
      * @param tx Pin number for transmitting data to N2CMU.
      */
+#ifdef ARDUINO
     N2Coprocessor(
         uint8_t rx = N2CMU_RX_PIN,
         uint8_t tx = N2CMU_TX_PIN
-    ): n2serial(new SoftwareSerial(rx, tx)) { }
+    ): n2serial(new SoftwareSerial(rx, tx)) {
+        this->initialize();
+    }
+#else
+    N2Coprocessor(
+        const char *device = N2CMU_DEVICE_PATH,
+        long baud = N2CMU_BAUD_RATE
+    ): n2serial(new N2PosixSerial(device, baud)) {
+        this->initialize();
+    }
+#endif
+
+    /**
+     * @brief Destructor, releases the serial transport, the recovery snapshot and the inference cache.
+     */
+    ~N2Coprocessor();
+
+    /**
+     * @brief Copying is not allowed, the copy would free the same buffers.
+     */
+    N2Coprocessor(const N2Coprocessor&) = delete;
+
+    /**
+     * @brief Copying is not allowed, the copy would free the same buffers.
+     */
+    N2Coprocessor& operator=(const N2Coprocessor&) = delete;
 
     /**
      * @brief Initialize the N2CMU device.
@@ -149,12 +768,73 @@ public:
      * This function resets the CPU of the N2CMU device,
      * restoring it to a known state. It can be useful
      * for recovering from unexpected errors or initializing
-     * the device before starting a new operation.
+     * the device before starting a new operation. The
+     * inference cache is cleared, since the device no
+     * longer holds the model it was filled from.
      * 
      * @return True if CPU reset was successful, false otherwise.
      */
     bool cpuReset();
 
+    /**
+     * @brief Set the response timeouts.
+     * 
+     * Every wait for a response from the N2CMU device is
+     * bounded by these timeouts, so a stalled device makes
+     * the operation fail instead of hanging the host.
+     * Training and on-device evaluation get their own
+     * timeout since they can take much longer than any
+     * other command.
+     * 
+     * @param timeout Time in milliseconds to wait for a response, 0 to wait forever.
+     * @param trainingTimeout Time in milliseconds to wait for training or evaluation, 0 to wait forever.
+     */
+    void setTimeout(unsigned long timeout, unsigned long trainingTimeout = 0);
+
+    /**
+     * @brief Enable or disable automatic recovery.
+     * 
+     * With recovery enabled, the library keeps a shadow
+     * snapshot of the topology, epoch count, weights and
+     * biases. When an operation times out and the device
+     * does not answer a handshake anymore, its CPU is
+     * reset, the model is restored from the snapshot and
+     * the operation is retried once.
+     * 
+     * Enabling recovery takes a snapshot of the current model.
+     * Training, sweeps and loading a model from flash take
+     * a new snapshot and fail if it cannot be read in full,
+     * in which case the previous snapshot is kept. Recovery
+     * fails rather than restoring a topology whose weights
+     * and biases are not all in the snapshot.
+     * 
+     * Recovery cannot be enabled during a model update,
+     * since the snapshot would hold the staged parameters.
+     * Disabling recovery releases the snapshot. Sketches
+     * which never call this function carry none of the
+     * recovery code.
+     * 
+     * @param enable True to enable recovery, false to disable it.
+     * @return True if the snapshot was taken, false otherwise.
+     */
+    bool setRecovery(bool enable);
+
+    /**
+     * @brief Take a snapshot of the model on N2CMU.
+     * 
+     * The snapshot is refreshed automatically after
+     * training and kept in sync by the set functions,
+     * but it can also be taken explicitly, for example
+     * after changing the model outside of this object.
+     * 
+     * The new snapshot replaces the previous one only
+     * once all of its arrays were read. No snapshot is
+     * taken during a model update or with recovery disabled.
+     * 
+     * @return True if the snapshot was taken, false otherwise.
+     */
+    bool snapshotModel();
+
     /**
      * @brief Create a neural network with specified input, hidden, and output neuron counts.
      * 
@@ -187,7 +867,7 @@ public:
      * @param output Pointer to the output data array.
      * @param len Length of the data arrays.
      * @param learningRate Learning rate for training.
-     * @return True if training was successful, false otherwise.
+     * @return True if training was successful, false otherwise or during a model update.
      */
     bool train(
         float* data,
@@ -196,6 +876,66 @@ public:
         float learningRate
     );
 
+    /**
+     * @brief Train the neural network with an optimizer configuration.
+     * 
+     * This function trains the neural network like
+     * the plain learning rate variant, but lets the
+     * N2CMU device apply momentum, a learning rate
+     * schedule and mini-batch updates. The number of
+     * epochs is still set with setEpochCount().
+     * 
+     * @param data Pointer to the input data array.
+     * @param output Pointer to the output data array.
+     * @param len Length of the data arrays.
+     * @param config Optimizer configuration.
+     * @return True if training was successful, false otherwise or during a model update.
+     */
+    bool train(
+        float* data,
+        float* output,
+        uint16_t len,
+        const N2TrainingConfig& config
+    );
+
+    /**
+     * @brief Report training progress through a callback.
+     * 
+     * This function makes the N2CMU device send a progress
+     * frame with the epoch number and current loss every
+     * given number of epochs during training. The callback
+     * can stop training early by returning false.
+     * 
+     * @param interval Number of epochs between progress frames, 0 to disable them.
+     * @param callback Progress callback, may be NULL.
+     * @param context User pointer passed to the callback.
+     */
+    void setTrainingProgress(
+        uint16_t interval,
+        N2ProgressCallback callback = NULL,
+        void* context = NULL
+    );
+
+    /**
+     * @brief Stop training early on a loss threshold or a plateau.
+     * 
+     * The rules are checked on every progress frame, so
+     * a progress interval must be set with
+     * setTrainingProgress(). Training stops when the loss
+     * drops below the threshold, or when it has not
+     * decreased by at least the minimum delta for the
+     * given number of consecutive frames.
+     * 
+     * @param lossThreshold Loss below which training stops, 0 to disable.
+     * @param patience Number of frames without improvement before training stops, 0 to disable.
+     * @param minDelta Smallest loss decrease counted as an improvement.
+     */
+    void setEarlyStopping(
+        float lossThreshold,
+        uint16_t patience = 0,
+        float minDelta = 0.0f
+    );
+
     /**
      * @brief Make inference with the neural network using provided input data.
      * 
@@ -211,6 +951,81 @@ public:
      */
     bool infer(float* input, float* output);
 
+    /**
+     * @brief Make several inferences back to back.
+     * 
+     * This function runs inference on a contiguous
+     * array of input vectors. The network topology is
+     * queried once for the whole batch instead of once
+     * per sample, so every sample costs a single
+     * request and response on the serial link.
+     * 
+     * @param inputs Pointer to the input data array (count * input neurons).
+     * @param outputs Pointer to store the output data array (count * output neurons).
+     * @param count Number of input vectors.
+     * @return True if all inferences were successful, false otherwise.
+     */
+    bool inferBatch(float* inputs, float* outputs, uint16_t count);
+
+    /**
+     * @brief Enable or disable the inference result cache.
+     * 
+     * With the cache enabled, infer() remembers the outputs
+     * of recent inputs and answers repeated inputs without
+     * any serial traffic. Inputs are keyed by a 32-bit hash,
+     * optionally after rounding every value to a multiple
+     * of the quantization step, so nearby inputs share one
+     * entry. Every function which changes the model, such
+     * as train(), the set functions, resetNetwork() and
+     * createNetwork(), empties the cache. Sketches which
+     * never call this function carry none of the cache code.
+     * 
+     * @param capacity Maximum number of cached results, 0 to disable the cache.
+     * @param quantization Quantization step of the inputs, 0 to hash exact values.
+     * @return True if the cache was allocated, false otherwise.
+     */
+    bool setInferenceCache(uint8_t capacity, float quantization = 0.0f);
+
+    /**
+     * @brief Empty the inference cache and reset its counters.
+     */
+    void clearInferenceCache();
+
+    /**
+     * @brief Get the number of inferences answered from the cache.
+     * @return Number of cache hits.
+     */
+    uint32_t getCacheHits();
+
+    /**
+     * @brief Get the number of inferences sent to the device while the cache is enabled.
+     * @return Number of cache misses.
+     */
+    uint32_t getCacheMisses();
+
+    /**
+     * @brief Evaluate the neural network over a data set on the device.
+     * 
+     * This function sends a whole validation set to the
+     * N2CMU device, which runs inference on every sample
+     * and returns the aggregate metrics in one response,
+     * instead of one round trip per sample.
+     * 
+     * @param inputs Pointer to the input data array (count * input neurons).
+     * @param targets Pointer to the expected output array (count * output neurons).
+     * @param count Number of samples in the data arrays.
+     * @param result Pointer to store the evaluation metrics.
+     * @param confusion True to also receive the confusion summary.
+     * @return True if evaluation was successful, false otherwise.
+     */
+    bool evaluate(
+        float* inputs,
+        float* targets,
+        uint16_t count,
+        N2Evaluation* result,
+        bool confusion = false
+    );
+
     /**
      * @brief Reset the neural network parameters.
      * 
@@ -316,6 +1131,89 @@ public:
      */
     uint16_t getEpochCount();
 
+    /**
+     * @brief Get the performance counters of the N2CMU device.
+     * 
+     * This function retrieves the compute timings and
+     * receive buffer statistics measured on the device.
+     * 
+     * @param perf Pointer to store the performance counters.
+     * @return True if the counters were received, false otherwise.
+     */
+    bool getDevicePerf(N2DevicePerf* perf);
+
+    /**
+     * @brief Get the number of values in a parameter array.
+     * 
+     * This function computes the size of a parameter
+     * array from the current network topology, which
+     * is queried from the N2CMU device.
+     * 
+     * @param parameter The parameter to get the size of.
+     * @return Number of float values in the parameter array.
+     */
+    uint16_t getParameterSize(N2CMUParameter parameter);
+
+    /**
+     * @brief Set the values of a parameter array.
+     * 
+     * This is the generic form of the set accessors below.
+     * 
+     * @param parameter The parameter to set.
+     * @param values Array of values, sized for the current topology.
+     * @return True if setting was successful, false otherwise.
+     */
+    bool setParameter(N2CMUParameter parameter, float* values);
+
+    /**
+     * @brief Get the values of a parameter array.
+     * 
+     * This is the generic form of the get accessors below.
+     * 
+     * @param parameter The parameter to get.
+     * @param values Array to store the values, sized for the current topology.
+     * @return True if getting was successful, false otherwise.
+     */
+    bool getParameter(N2CMUParameter parameter, float* values);
+
+    /**
+     * @brief Stream the values of a parameter array to the device.
+     * 
+     * Like setParameter(), but the values are asked from the
+     * callback one at a time, so they can come from storage
+     * instead of RAM. If the set fails with recovery enabled,
+     * the snapshot no longer holds the array until the next
+     * one is taken.
+     * 
+     * @param parameter The parameter to set.
+     * @param callback Callback supplying every value.
+     * @param context User pointer passed to the callback.
+     * @return True if setting was successful, false otherwise.
+     */
+    bool setParameter(
+        N2CMUParameter parameter,
+        N2ParameterCallback callback,
+        void* context
+    );
+
+    /**
+     * @brief Stream the values of a parameter array from the device.
+     * 
+     * Like getParameter(), but every value is handed to the
+     * callback as it arrives.
+     * 
+     * @param parameter The parameter to get.
+     * @param callback Callback receiving every value.
+     * @param context User pointer passed to the callback.
+     * @return True if getting was successful, false otherwise.
+     */
+    bool getParameter(
+        N2CMUParameter parameter,
+        N2ParameterCallback callback,
+        void* context
+    );
+
+#ifndef N2CMU_NO_NEURON_ACCESSORS
     /**
      * @brief Set hidden neuron values.
      * 
@@ -328,7 +1226,9 @@ public:
      * @param hiddenNeuron Array of hidden neuron values.
      * @return True if setting was successful, false otherwise.
      */
-    bool setHiddenNeuron(float* hiddenNeuron);
+    bool setHiddenNeuron(float* hiddenNeuron) {
+        return this->setParameter(N2CMU_PARAM_HIDDEN_NEURON, hiddenNeuron);
+    }
 
     /**
      * @brief Set output neuron values.
@@ -341,7 +1241,10 @@ public:
      * @param outputNeuron Array of output neuron values.
      * @return True if setting was successful, false otherwise.
      */
-    bool setOutputNeuron(float* outputNeuron);
+    bool setOutputNeuron(float* outputNeuron) {
+        return this->setParameter(N2CMU_PARAM_OUTPUT_NEURON, outputNeuron);
+    }
+#endif
 
     /**
      * @brief Set hidden neuron weights.
@@ -354,7 +1257,9 @@ public:
      * @param hiddenWeights Array of hidden neuron weights.
      * @return True if setting was successful, false otherwise.
      */
-    bool setHiddenWeights(float* hiddenWeights);
+    bool setHiddenWeights(float* hiddenWeights) {
+        return this->setParameter(N2CMU_PARAM_HIDDEN_WEIGHTS, hiddenWeights);
+    }
 
     /**
      * @brief Set output neuron weights.
@@ -367,7 +1272,9 @@ public:
      * @param outputWeights Array of output neuron weights.
      * @return True if setting was successful, false otherwise.
      */
-    bool setOutputWeights(float* outputWeights);
+    bool setOutputWeights(float* outputWeights) {
+        return this->setParameter(N2CMU_PARAM_OUTPUT_WEIGHTS, outputWeights);
+    }
 
     /**
      * @brief Set hidden neuron biases.
@@ -380,7 +1287,9 @@ public:
      * @param hiddenBias Array of hidden neuron biases.
      * @return True if setting was successful, false otherwise.
      */
-    bool setHiddenBias(float* hiddenBias);
+    bool setHiddenBias(float* hiddenBias) {
+        return this->setParameter(N2CMU_PARAM_HIDDEN_BIAS, hiddenBias);
+    }
 
     /**
      * @brief Set output neuron biases.
@@ -393,8 +1302,11 @@ public:
      * @param outputBias Array of output neuron biases.
      * @return True if setting was successful, false otherwise.
      */
-    bool setOutputBias(float* outputBias);
+    bool setOutputBias(float* outputBias) {
+        return this->setParameter(N2CMU_PARAM_OUTPUT_BIAS, outputBias);
+    }
 
+#ifndef N2CMU_NO_GRADIENT_ACCESSORS
     /**
      * @brief Set hidden neuron gradients.
      * 
@@ -407,7 +1319,9 @@ public:
      * @param hiddenGrad Array of hidden neuron gradients.
      * @return True if setting was successful, false otherwise.
      */
-    bool setHiddenGradient(float* hiddenGrad);
+    bool setHiddenGradient(float* hiddenGrad) {
+        return this->setParameter(N2CMU_PARAM_HIDDEN_GRAD, hiddenGrad);
+    }
 
     /**
      * @brief Set output neuron gradients.
@@ -421,8 +1335,12 @@ public:
      * @param outputGrad Array of output neuron gradients.
      * @return True if setting was successful, false otherwise.
      */
-    bool setOutputGradient(float* outputGrad);
+    bool setOutputGradient(float* outputGrad) {
+        return this->setParameter(N2CMU_PARAM_OUTPUT_GRAD, outputGrad);
+    }
+#endif
 
+#ifndef N2CMU_NO_NEURON_ACCESSORS
     /**
      * @brief Get hidden neuron values.
      * 
@@ -434,7 +1352,9 @@ public:
      * 
      * @param hiddenNeuron Array to store hidden neuron values.
      */
-    void getHiddenNeuron(float* hiddenNeuron);
+    void getHiddenNeuron(float* hiddenNeuron) {
+        this->getParameter(N2CMU_PARAM_HIDDEN_NEURON, hiddenNeuron);
+    }
 
     /**
      * @brief Get output neuron values.
@@ -447,7 +1367,10 @@ public:
      * 
      * @param outputNeuron Array to store output neuron values.
      */
-    void getOutputNeuron(float* outputNeuron);
+    void getOutputNeuron(float* outputNeuron) {
+        this->getParameter(N2CMU_PARAM_OUTPUT_NEURON, outputNeuron);
+    }
+#endif
 
     /**
      * @brief Get hidden neuron weights.
@@ -461,7 +1384,9 @@ public:
      * 
      * @param hiddenWeights Array to store hidden neuron weights.
      */
-    void getHiddenWeights(float* hiddenWeights);
+    void getHiddenWeights(float* hiddenWeights) {
+        this->getParameter(N2CMU_PARAM_HIDDEN_WEIGHTS, hiddenWeights);
+    }
 
     /**
      * @brief Get output neuron weights.
@@ -475,7 +1400,9 @@ public:
      * 
      * @param outputWeights Array to store output neuron weights.
      */
-    void getOutputWeights(float* outputWeights);
+    void getOutputWeights(float* outputWeights) {
+        this->getParameter(N2CMU_PARAM_OUTPUT_WEIGHTS, outputWeights);
+    }
 
     /**
      * @brief Get hidden neuron biases.
@@ -488,7 +1415,9 @@ public:
      * 
      * @param hiddenBias Array to store hidden neuron biases.
      */
-    void getHiddenBias(float* hiddenBias);
+    void getHiddenBias(float* hiddenBias) {
+        this->getParameter(N2CMU_PARAM_HIDDEN_BIAS, hiddenBias);
+    }
 
     /**
      * @brief Get output neuron biases.
@@ -501,8 +1430,11 @@ public:
      * 
      * @param outputBias Array to store output neuron biases.
      */
-    void getOutputBias(float* outputBias);
+    void getOutputBias(float* outputBias) {
+        this->getParameter(N2CMU_PARAM_OUTPUT_BIAS, outputBias);
+    }
 
+#ifndef N2CMU_NO_GRADIENT_ACCESSORS
     /**
      * @brief Get hidden neuron gradients.
      * 
@@ -514,7 +1446,9 @@ public:
      * 
      * @param hiddenGrad Array to store hidden neuron gradients.
      */
-    void getHiddenGradient(float* hiddenGrad);
+    void getHiddenGradient(float* hiddenGrad) {
+        this->getParameter(N2CMU_PARAM_HIDDEN_GRAD, hiddenGrad);
+    }
 
     /**
      * @brief Get output neuron gradients.
@@ -527,7 +1461,147 @@ public:
      * 
      * @param outputGrad Array to store output neuron gradients.
      */
-    void getOutputGradient(float* outputGrad);
+    void getOutputGradient(float* outputGrad) {
+        this->getParameter(N2CMU_PARAM_OUTPUT_GRAD, outputGrad);
+    }
+#endif
+
+    /**
+     * @brief Load a pretrained model from program memory.
+     * 
+     * This function creates the network described by the
+     * model and streams its weights and biases from flash
+     * straight to the N2CMU device, one value at a time,
+     * without copying them into RAM first. Like
+     * createNetwork(), it discards a pending model update.
+     * 
+     * @param model Pointer to the model, which must itself be in PROGMEM.
+     * @return True if the model was loaded, false otherwise.
+     */
+    bool loadFromProgmem(const N2ProgmemModel* model);
+
+    /**
+     * @brief Start a model update in the staging slot.
+     * 
+     * The N2CMU device copies the active weights and biases
+     * into a staging slot. Until commitModel() or
+     * discardModelUpdate() is called, every set call for
+     * weights, biases, neurons and gradients writes to the
+     * staging slot and the matching get calls read from it,
+     * while infer() and the rest keep using the active
+     * model. Parameters which are not uploaded keep their
+     * active values.
+     * 
+     * Changing the topology, loading a model from flash,
+     * running a sweep or resetting the CPU discards the
+     * update. Training, snapshots and checkpoints are
+     * refused until the update is committed or discarded.
+     * 
+     * @return True if the staging slot was opened, false otherwise.
+     */
+    bool beginModelUpdate();
+
+    /**
+     * @brief Check whether a model update is in progress.
+     * @return True between beginModelUpdate() and its commit or discard, false otherwise.
+     */
+    bool isUpdatingModel() const {
+        return this->staging;
+    }
+
+    /**
+     * @brief Swap the staged model in.
+     * 
+     * The N2CMU device swaps the staging slot and the active
+     * model between two commands, so no inference can see a
+     * half-updated model. The inference cache is emptied and,
+     * with recovery enabled, the model is snapshotted again.
+     * 
+     * If the device was reset during the update, the staged
+     * parameters are gone and the update is discarded
+     * instead. The commit is never sent twice: if its status
+     * is lost, the device may or may not have swapped the
+     * models, so the update is discarded as well and the
+     * device keeps whichever model it has active. The cache
+     * is emptied and, with recovery enabled, that model is
+     * snapshotted.
+     * 
+     * With recovery enabled, the commit fails if the new
+     * model cannot be snapshotted, although it is active.
+     * 
+     * @return True if the staged model is now active, false otherwise.
+     */
+    bool commitModel();
+
+    /**
+     * @brief Discard a model update started with beginModelUpdate().
+     * @return True if the staging slot was discarded, false otherwise.
+     */
+    bool discardModelUpdate();
+
+    /**
+     * @brief Run a hyperparameter sweep on the device.
+     * 
+     * This function sends the data set once, followed by
+     * the list of candidate configurations. The N2CMU
+     * device trains a fresh network for every candidate
+     * on the training split, scores it by the mean squared
+     * error on the validation split, and finally keeps the
+     * topology, weights and biases of the best candidate
+     * as the active model. A pending model update is
+     * discarded first.
+     * 
+     * The validation split is made of the last samples of
+     * the data set, so the data should be shuffled first.
+     * 
+     * @param data Pointer to the input data array.
+     * @param output Pointer to the output data array.
+     * @param len Length of the data arrays.
+     * @param validationCount Number of trailing samples used for validation.
+     * @param configs Array of candidate configurations.
+     * @param configCount Number of candidate configurations.
+     * @param scores Array to store the validation error of every candidate, may be NULL.
+     * @param best Pointer to store the index of the best candidate.
+     * @return True if the sweep was successful, false otherwise.
+     */
+    bool sweep(
+        float* data,
+        float* output,
+        uint16_t len,
+        uint16_t validationCount,
+        const N2SweepConfig* configs,
+        uint8_t configCount,
+        float* scores,
+        uint8_t* best
+    );
+
+    /**
+     * @brief Build the candidate list of a grid sweep.
+     * 
+     * This function fills the configuration array with
+     * every combination of the given hidden neuron counts,
+     * learning rates and epoch counts. A sweep takes at
+     * most 255 candidates, so nothing is stored when the
+     * grid has more combinations than that.
+     * 
+     * @param hiddenCounts Array of hidden neuron counts.
+     * @param hiddenLen Number of hidden neuron counts.
+     * @param learningRates Array of learning rates.
+     * @param rateLen Number of learning rates.
+     * @param epochCounts Array of epoch counts.
+     * @param epochLen Number of epoch counts.
+     * @param configs Array to store the configurations, sized for all combinations.
+     * @return Number of configurations stored, 0 if the grid has more than 255.
+     */
+    static uint8_t buildSweepGrid(
+        const uint8_t* hiddenCounts,
+        uint8_t hiddenLen,
+        const float* learningRates,
+        uint8_t rateLen,
+        const uint16_t* epochCounts,
+        uint8_t epochLen,
+        N2SweepConfig* configs
+    );
 
     // Not yet implemented.
     void loadFromFile(const char *modelFilename);
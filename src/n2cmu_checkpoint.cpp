@@ -0,0 +1,574 @@
+/*
+ * This file is part of the N2CMU Arduino library (https://github.com/nthnn/n2cmu-arduino).
+ * Copyright (c) 2024 Nathanne Isip.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "n2cmu_checkpoint.h"
+
+#ifdef N2CMU_HAS_EEPROM
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#include <EEPROM.h>
+#else
+#include <stdlib.h>
+#include <string.h>
+#endif
+
+#define N2CMU_CHECKPOINT_VALUES (N2CMU_CHECKPOINT_PAYLOAD / sizeof(float))
+
+/**
+ * @brief State of a checkpoint streamed from or to the coprocessor.
+ */
+typedef struct N2CheckpointStream {
+    N2Checkpoint* checkpoint;   ///< Checkpoint being saved or restored.
+    uint16_t base;              ///< Position of the current parameter array in the model.
+    uint16_t total;             ///< Number of values in the model.
+    uint16_t block;             ///< Block held in the buffer, N2CMU_CHECKPOINT_NONE if none.
+    uint16_t* slots;            ///< Slot of every block.
+    const uint16_t* previous;   ///< Slot of every block in the last checkpoint, NULL if unrelated.
+    bool result;                ///< False once a block could not be read.
+    float buffer[N2CMU_CHECKPOINT_VALUES];  ///< Values of the current block.
+} N2CheckpointStream;
+
+N2Checkpoint::N2Checkpoint(
+    N2Coprocessor& coprocessor,
+    uint16_t address,
+    uint16_t length
+): coprocessor(coprocessor) {
+    this->address = address;
+    this->length = length;
+    this->slotCount = 0;
+    this->cursor = 0;
+    this->sequence = 0;
+    this->commitSlot = N2CMU_CHECKPOINT_NONE;
+    this->topology[0] = this->topology[1] = this->topology[2] = 0;
+    this->epochCount = 0;
+    this->blockCount = 0;
+    this->slots = NULL;
+    this->lastWrites = 0;
+    this->pending = NULL;
+    this->pendingCount = 0;
+}
+
+N2Checkpoint::~N2Checkpoint() {
+    free(this->slots);
+}
+
+uint16_t N2Checkpoint::crc16(uint16_t crc, const uint8_t* data, uint8_t length) {
+    while(length-- > 0) {
+        crc ^= (uint16_t) *data++ << 8;
+
+        for(uint8_t i = 0; i < 8; i++)
+            crc = (crc & 0x8000) ?
+                (uint16_t) ((crc << 1) ^ 0x1021) :
+                (uint16_t) (crc << 1);
+    }
+
+    return crc;
+}
+
+uint16_t N2Checkpoint::parameterSize(const uint8_t* topology, uint8_t index) {
+    switch(index + N2CMU_PARAM_HIDDEN_WEIGHTS) {
+        case N2CMU_PARAM_HIDDEN_WEIGHTS:
+            return (uint16_t) topology[0] * topology[1];
+
+        case N2CMU_PARAM_OUTPUT_WEIGHTS:
+            return (uint16_t) topology[1] * topology[2];
+
+        case N2CMU_PARAM_HIDDEN_BIAS:
+            return topology[1];
+
+        default:
+            return topology[2];
+    }
+}
+
+uint32_t N2Checkpoint::modelSize(const uint8_t* topology) {
+    uint32_t size = 0;
+
+    for(uint8_t i = 0; i < N2CMU_SNAPSHOT_PARAMS; i++)
+        size += parameterSize(topology, i);
+
+    return size;
+}
+
+uint32_t N2Checkpoint::modelBlocks(const uint8_t* topology) {
+    return (modelSize(topology) + N2CMU_CHECKPOINT_VALUES - 1) /
+        N2CMU_CHECKPOINT_VALUES;
+}
+
+bool N2Checkpoint::fits(uint32_t blocks) const {
+    // The committed checkpoint stays intact while the next one
+    // is written, each with its blocks and a commit record.
+    return 2 * blocks + 2 <= this->slotCount;
+}
+
+uint32_t N2Checkpoint::getRequiredSize(
+    uint8_t inputCount,
+    uint8_t hiddenCount,
+    uint8_t outputCount
+) {
+    const uint8_t topology[3] = {inputCount, hiddenCount, outputCount};
+    return (2 * modelBlocks(topology) + 2) * N2CMU_CHECKPOINT_SLOT;
+}
+
+void N2Checkpoint::writeByte(uint16_t offset, uint8_t value) {
+#ifdef N2CMU_BUFFERED_EEPROM
+    EEPROM.write(this->address + offset, value);
+#else
+    EEPROM.update(this->address + offset, value);
+#endif
+}
+
+bool N2Checkpoint::readSlot(
+    uint16_t slot,
+    uint16_t* block,
+    uint32_t* sequence,
+    uint8_t* payload
+) {
+    uint8_t data[N2CMU_CHECKPOINT_SLOT];
+    uint16_t offset = slot * N2CMU_CHECKPOINT_SLOT;
+
+    for(uint8_t i = 0; i < N2CMU_CHECKPOINT_SLOT; i++)
+        data[i] = EEPROM.read(this->address + offset + i);
+
+    uint16_t crc = this->crc16(0xffff, data, 6);
+    crc = this->crc16(
+        crc,
+        data + N2CMU_CHECKPOINT_HEADER,
+        N2CMU_CHECKPOINT_PAYLOAD
+    );
+
+    *block = (uint16_t) (data[0] | (data[1] << 8));
+    *sequence = (uint32_t) data[2] |
+        ((uint32_t) data[3] << 8) |
+        ((uint32_t) data[4] << 16) |
+        ((uint32_t) data[5] << 24);
+
+    if(crc != (uint16_t) (data[6] | (data[7] << 8)) ||
+        *sequence == 0xffffffff)
+        return false;
+
+    if(payload != NULL)
+        memcpy(
+            payload,
+            data + N2CMU_CHECKPOINT_HEADER,
+            N2CMU_CHECKPOINT_PAYLOAD
+        );
+
+    return true;
+}
+
+bool N2Checkpoint::isLive(uint16_t slot) {
+    if(slot == this->commitSlot)
+        return true;
+
+    for(uint16_t i = 0; i < this->blockCount; i++)
+        if(this->slots[i] == slot)
+            return true;
+
+    for(uint16_t i = 0; i < this->pendingCount; i++)
+        if(this->pending[i] == slot)
+            return true;
+
+    return false;
+}
+
+bool N2Checkpoint::matchesSlot(uint16_t slot, const uint8_t* payload) {
+    uint16_t offset = this->address +
+        slot * N2CMU_CHECKPOINT_SLOT +
+        N2CMU_CHECKPOINT_HEADER;
+
+    for(uint8_t i = 0; i < N2CMU_CHECKPOINT_PAYLOAD; i++)
+        if(EEPROM.read(offset + i) != payload[i])
+            return false;
+
+    return true;
+}
+
+uint16_t N2Checkpoint::writeSlot(uint16_t block, const uint8_t* payload) {
+    while(this->isLive(this->cursor))
+        this->cursor = (this->cursor + 1) % this->slotCount;
+
+    uint16_t slot = this->cursor;
+    this->cursor = (this->cursor + 1) % this->slotCount;
+
+    uint8_t header[N2CMU_CHECKPOINT_HEADER];
+    header[0] = (uint8_t) block;
+    header[1] = (uint8_t) (block >> 8);
+
+    for(uint8_t i = 0; i < 4; i++)
+        header[2 + i] = (uint8_t) (this->sequence >> (8 * i));
+    this->sequence++;
+
+    uint16_t crc = this->crc16(0xffff, header, 6);
+    crc = this->crc16(crc, payload, N2CMU_CHECKPOINT_PAYLOAD);
+    header[6] = (uint8_t) crc;
+    header[7] = (uint8_t) (crc >> 8);
+
+    uint16_t offset = slot * N2CMU_CHECKPOINT_SLOT;
+    for(uint8_t i = 0; i < N2CMU_CHECKPOINT_PAYLOAD; i++)
+        this->writeByte(offset + N2CMU_CHECKPOINT_HEADER + i, payload[i]);
+
+    for(uint8_t i = 0; i < N2CMU_CHECKPOINT_HEADER; i++)
+        this->writeByte(offset + i, header[i]);
+
+    return slot;
+}
+
+void N2Checkpoint::eraseSlot(uint16_t slot) {
+    uint16_t offset = slot * N2CMU_CHECKPOINT_SLOT + 6;
+
+    for(uint8_t i = 0; i < 2; i++)
+        this->writeByte(
+            offset + i,
+            (uint8_t) ~EEPROM.read(this->address + offset + i)
+        );
+}
+
+bool N2Checkpoint::begin() {
+    free(this->slots);
+    this->slots = NULL;
+    this->blockCount = 0;
+    this->commitSlot = N2CMU_CHECKPOINT_NONE;
+    this->lastWrites = 0;
+
+#ifdef N2CMU_BUFFERED_EEPROM
+    EEPROM.begin(this->address + this->length);
+#endif
+
+    uint16_t size = EEPROM.length();
+    if(this->address >= size)
+        this->length = 0;
+    else if(this->length > size - this->address)
+        this->length = size - this->address;
+    this->slotCount = this->length / N2CMU_CHECKPOINT_SLOT;
+
+    uint16_t block, last = N2CMU_CHECKPOINT_NONE,
+        commit = N2CMU_CHECKPOINT_NONE;
+    uint32_t sequence, lastSequence = 0, commitSequence = 0;
+
+    for(uint16_t slot = 0; slot < this->slotCount; slot++) {
+        if(!this->readSlot(slot, &block, &sequence, NULL))
+            continue;
+
+        if(last == N2CMU_CHECKPOINT_NONE || sequence > lastSequence) {
+            last = slot;
+            lastSequence = sequence;
+        }
+
+        if(block == N2CMU_CHECKPOINT_COMMIT &&
+            (commit == N2CMU_CHECKPOINT_NONE || sequence > commitSequence)) {
+            commit = slot;
+            commitSequence = sequence;
+        }
+    }
+
+    // Blocks of a checkpoint interrupted before its commit record
+    // would otherwise look like the newest copies to the next one.
+    bool erased = false;
+    for(uint16_t slot = 0; slot < this->slotCount; slot++)
+        if(this->readSlot(slot, &block, &sequence, NULL) &&
+            (commit == N2CMU_CHECKPOINT_NONE || sequence > commitSequence)) {
+            this->eraseSlot(slot);
+            erased = true;
+        }
+
+#ifdef N2CMU_BUFFERED_EEPROM
+    if(erased)
+        EEPROM.commit();
+#else
+    (void) erased;
+#endif
+
+    this->sequence = last == N2CMU_CHECKPOINT_NONE ? 0 : lastSequence + 1;
+    this->cursor = last == N2CMU_CHECKPOINT_NONE ? 0 :
+        (last + 1) % this->slotCount;
+
+    if(commit != N2CMU_CHECKPOINT_NONE)
+        return this->restore(commit, commitSequence);
+
+    uint8_t topology[3] = {
+        this->coprocessor.getInputCount(),
+        this->coprocessor.getHiddenCount(),
+        this->coprocessor.getOutputCount()
+    };
+
+    if(!this->fits(this->modelBlocks(topology)))
+        this->slotCount = 0;
+    return false;
+}
+
+void N2Checkpoint::saveValue(uint16_t index, float* value, void* context) {
+    N2CheckpointStream* stream = (N2CheckpointStream*) context;
+    N2Checkpoint* checkpoint = stream->checkpoint;
+    uint16_t position = stream->base + index;
+    uint8_t offset = position % N2CMU_CHECKPOINT_VALUES;
+
+    stream->buffer[offset] = *value;
+    if(offset != N2CMU_CHECKPOINT_VALUES - 1 &&
+        position != stream->total - 1)
+        return;
+
+    // The last block is padded with zeros.
+    while(++offset < N2CMU_CHECKPOINT_VALUES)
+        stream->buffer[offset] = 0.0f;
+
+    uint16_t block = position / N2CMU_CHECKPOINT_VALUES;
+    uint16_t current = stream->slots[block];
+    const uint8_t* payload = (const uint8_t*) stream->buffer;
+
+    if(current != N2CMU_CHECKPOINT_NONE &&
+        checkpoint->matchesSlot(current, payload))
+        return;
+
+    // A transfer started over after a timeout may deliver a block
+    // again with other values; its first copy must not survive.
+    if(current != N2CMU_CHECKPOINT_NONE &&
+        (stream->previous == NULL || current != stream->previous[block])) {
+        stream->slots[block] = N2CMU_CHECKPOINT_NONE;
+        checkpoint->eraseSlot(current);
+    }
+
+    stream->slots[block] = checkpoint->writeSlot(block, payload);
+}
+
+void N2Checkpoint::restoreValue(uint16_t index, float* value, void* context) {
+    N2CheckpointStream* stream = (N2CheckpointStream*) context;
+    uint16_t position = stream->base + index;
+    uint16_t block = position / N2CMU_CHECKPOINT_VALUES;
+
+    if(block != stream->block) {
+        uint16_t number;
+        uint32_t sequence;
+
+        stream->block = block;
+        if(!stream->checkpoint->readSlot(
+            stream->slots[block],
+            &number,
+            &sequence,
+            (uint8_t*) stream->buffer
+        ))
+            stream->result = false;
+    }
+
+    *value = stream->buffer[position % N2CMU_CHECKPOINT_VALUES];
+}
+
+bool N2Checkpoint::restore(uint16_t slot, uint32_t commit) {
+    uint8_t record[N2CMU_CHECKPOINT_PAYLOAD];
+    uint16_t block;
+    uint32_t sequence;
+
+    if(!this->readSlot(slot, &block, &sequence, record))
+        return false;
+
+    uint16_t blocks = (uint16_t) (record[5] | (record[6] << 8));
+    if(blocks == 0 || blocks != this->modelBlocks(record))
+        return false;
+
+    if(!this->fits(blocks)) {
+        this->slotCount = 0;
+        return false;
+    }
+
+    uint16_t* slots = (uint16_t*) malloc(blocks * sizeof(uint16_t));
+    uint32_t* sequences = (uint32_t*) malloc(blocks * sizeof(uint32_t));
+    if(slots == NULL || sequences == NULL) {
+        free(slots);
+        free(sequences);
+
+        return false;
+    }
+
+    for(uint16_t i = 0; i < blocks; i++)
+        slots[i] = N2CMU_CHECKPOINT_NONE;
+
+    for(uint16_t i = 0; i < this->slotCount; i++)
+        if(this->readSlot(i, &block, &sequence, NULL) &&
+            block < blocks && sequence < commit &&
+            (slots[block] == N2CMU_CHECKPOINT_NONE ||
+                sequence > sequences[block])) {
+            slots[block] = i;
+            sequences[block] = sequence;
+        }
+    free(sequences);
+
+    for(uint16_t i = 0; i < blocks; i++)
+        if(slots[i] == N2CMU_CHECKPOINT_NONE) {
+            free(slots);
+            return false;
+        }
+
+    this->slots = slots;
+    this->blockCount = blocks;
+    this->commitSlot = slot;
+    this->topology[0] = record[0];
+    this->topology[1] = record[1];
+    this->topology[2] = record[2];
+    this->epochCount = (uint16_t) (record[3] | (record[4] << 8));
+
+    this->coprocessor.createNetwork(
+        this->topology[0],
+        this->topology[1],
+        this->topology[2]
+    );
+    this->coprocessor.setEpochCount(this->epochCount);
+
+    N2CheckpointStream stream;
+    stream.checkpoint = this;
+    stream.base = 0;
+    stream.total = (uint16_t) this->modelSize(this->topology);
+    stream.block = N2CMU_CHECKPOINT_NONE;
+    stream.slots = slots;
+    stream.previous = NULL;
+    stream.result = true;
+
+    bool result = true;
+    for(uint8_t i = 0; i < N2CMU_SNAPSHOT_PARAMS && result; i++) {
+        result = this->coprocessor.setParameter(
+            (N2CMUParameter) (i + N2CMU_PARAM_HIDDEN_WEIGHTS),
+            restoreValue,
+            &stream
+        ) && stream.result;
+        stream.base += this->parameterSize(this->topology, i);
+    }
+
+    return result;
+}
+
+bool N2Checkpoint::save() {
+    this->lastWrites = 0;
+    if(this->slotCount < 2 || this->coprocessor.isUpdatingModel())
+        return false;
+
+    uint8_t topology[3] = {
+        this->coprocessor.getInputCount(),
+        this->coprocessor.getHiddenCount(),
+        this->coprocessor.getOutputCount()
+    };
+    uint16_t epochCount = this->coprocessor.getEpochCount();
+
+    if(topology[0] == 0 || topology[1] == 0 || topology[2] == 0)
+        return false;
+
+    uint32_t blocks = this->modelBlocks(topology);
+    if(!this->fits(blocks))
+        return false;
+
+    uint16_t* slots = (uint16_t*) malloc(blocks * sizeof(uint16_t));
+    if(slots == NULL)
+        return false;
+
+    bool sameTopology = this->commitSlot != N2CMU_CHECKPOINT_NONE &&
+        memcmp(topology, this->topology, sizeof(topology)) == 0;
+
+    // Blocks start out in their slot of the last checkpoint, and
+    // the ones which changed are moved to a new slot as they arrive.
+    for(uint16_t i = 0; i < blocks; i++)
+        slots[i] = sameTopology ? this->slots[i] : N2CMU_CHECKPOINT_NONE;
+
+    N2CheckpointStream stream;
+    stream.checkpoint = this;
+    stream.base = 0;
+    stream.total = (uint16_t) this->modelSize(topology);
+    stream.block = N2CMU_CHECKPOINT_NONE;
+    stream.slots = slots;
+    stream.previous = sameTopology ? this->slots : NULL;
+    stream.result = true;
+
+    this->pending = slots;
+    this->pendingCount = blocks;
+
+    bool result = true;
+    for(uint8_t i = 0; i < N2CMU_SNAPSHOT_PARAMS && result; i++) {
+        result = this->coprocessor.getParameter(
+            (N2CMUParameter) (i + N2CMU_PARAM_HIDDEN_WEIGHTS),
+            saveValue,
+            &stream
+        );
+        stream.base += this->parameterSize(topology, i);
+    }
+
+    this->pending = NULL;
+    this->pendingCount = 0;
+
+    uint16_t dirty = 0;
+    for(uint16_t i = 0; i < blocks; i++)
+        if(slots[i] != N2CMU_CHECKPOINT_NONE &&
+            (!sameTopology || slots[i] != this->slots[i])) {
+            // Without a commit record, blocks written so far would
+            // look like the newest copies to the next checkpoint.
+            if(!result)
+                this->eraseSlot(slots[i]);
+            dirty++;
+        }
+
+    if(!result || (dirty == 0 && sameTopology &&
+        epochCount == this->epochCount)) {
+        free(slots);
+        return result;
+    }
+
+    uint8_t record[N2CMU_CHECKPOINT_PAYLOAD];
+    memset(record, 0, sizeof(record));
+    memcpy(record, topology, sizeof(topology));
+
+    record[3] = (uint8_t) epochCount;
+    record[4] = (uint8_t) (epochCount >> 8);
+    record[5] = (uint8_t) blocks;
+    record[6] = (uint8_t) (blocks >> 8);
+
+    uint16_t commit = this->writeSlot(N2CMU_CHECKPOINT_COMMIT, record);
+
+#ifdef N2CMU_BUFFERED_EEPROM
+    if(!EEPROM.commit()) {
+        free(slots);
+        return false;
+    }
+#endif
+
+    free(this->slots);
+    this->slots = slots;
+    this->blockCount = blocks;
+    this->commitSlot = commit;
+    memcpy(this->topology, topology, sizeof(topology));
+    this->epochCount = epochCount;
+    this->lastWrites = dirty + 1;
+
+    return true;
+}
+
+void N2Checkpoint::clear() {
+    uint16_t block;
+    uint32_t sequence;
+
+    for(uint16_t slot = 0; slot < this->slotCount; slot++)
+        if(this->readSlot(slot, &block, &sequence, NULL))
+            this->eraseSlot(slot);
+
+#ifdef N2CMU_BUFFERED_EEPROM
+    EEPROM.commit();
+#endif
+
+    free(this->slots);
+    this->slots = NULL;
+    this->blockCount = 0;
+    this->commitSlot = N2CMU_CHECKPOINT_NONE;
+    this->lastWrites = 0;
+}
+
+#endif
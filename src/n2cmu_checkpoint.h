@@ -0,0 +1,302 @@
+/*
+ * This file is part of the N2CMU Arduino library (https://github.com/nthnn/n2cmu-arduino).
+ * Copyright (c) 2024 Nathanne Isip.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file n2cmu_checkpoint.h
+ * @brief Header file for incremental model checkpoints in EEPROM.
+ * @author [Nathanne Isip](https://github.com/nthnn)
+ *
+ * This header file defines the N2Checkpoint class, which keeps the
+ * weights and biases of the N2CMU model in EEPROM so they survive a
+ * power cut. The model is split into fixed-size blocks stored in a
+ * ring of CRC-protected slots. A checkpoint only writes the blocks
+ * which changed, followed by a commit record, and the ring spreads
+ * the writes over the whole region. It is available on cores which
+ * provide the EEPROM library, and on Linux through a backing file.
+ *
+ * The region must hold two checkpoints at once, the committed one and
+ * the one being written: 2 * blocks + 2 slots, where a model has one
+ * block per eight weights and biases. getRequiredSize() computes this
+ * for a topology.
+ */
+#ifndef N2CMU_CHECKPOINT_H
+#define N2CMU_CHECKPOINT_H
+
+#if defined(ARDUINO_ARCH_AVR) || defined(ARDUINO_ARCH_MEGAAVR) || \
+    defined(ARDUINO_ARCH_RP2040) || defined(ESP32) || \
+    defined(ESP8266) || !defined(ARDUINO)
+#define N2CMU_HAS_EEPROM ///< Defined when N2Checkpoint is available.
+#endif
+
+#ifdef N2CMU_HAS_EEPROM
+
+#include "n2cmu.h"
+
+#if defined(ARDUINO_ARCH_RP2040) || defined(ESP32) || \
+    defined(ESP8266) || !defined(ARDUINO)
+#define N2CMU_BUFFERED_EEPROM ///< Defined when the EEPROM needs begin() and commit().
+#endif
+
+#define N2CMU_CHECKPOINT_SIZE 1024      ///< Default size of the checkpoint region in bytes.
+#define N2CMU_CHECKPOINT_HEADER 8       ///< Size of a slot header: block, sequence and CRC.
+#define N2CMU_CHECKPOINT_PAYLOAD 32     ///< Size of a slot payload, eight parameters.
+#define N2CMU_CHECKPOINT_SLOT 40        ///< Size of a slot, header and payload.
+#define N2CMU_CHECKPOINT_COMMIT 0xffff  ///< Block number of a commit record.
+#define N2CMU_CHECKPOINT_NONE 0xffff    ///< Slot index meaning no slot.
+
+/**
+ * @class N2Checkpoint
+ * @brief Wear-leveled incremental checkpoints of an N2CMU model.
+ *
+ * The N2Checkpoint class reads the model from the coprocessor with
+ * the regular get calls and compares every block with its copy in
+ * EEPROM, so a checkpoint after a short training session only costs
+ * the blocks that moved. New copies never overwrite the slots of the
+ * last committed checkpoint, hence a power cut at any point leaves
+ * either the old or the new checkpoint intact.
+ *
+ * The model is streamed block by block between the coprocessor and
+ * EEPROM, so no copy of it is ever held in RAM.
+ *
+ * Each slot holds a header with the block number, a sequence number
+ * and a CRC-16, followed by the payload. A checkpoint is complete once
+ * its commit record, which carries the topology and epoch count, is
+ * written with a higher sequence number than all of its blocks.
+ */
+class N2Checkpoint {
+private:
+    N2Coprocessor& coprocessor;  ///< Coprocessor whose model is checkpointed.
+    uint16_t address;            ///< First EEPROM address of the checkpoint region.
+    uint16_t length;             ///< Size of the checkpoint region in bytes.
+    uint16_t slotCount;          ///< Number of slots in the region.
+    uint16_t cursor;             ///< Next slot to consider for writing.
+    uint32_t sequence;           ///< Sequence number of the next slot written.
+    uint16_t commitSlot;         ///< Slot of the last commit record.
+    uint8_t topology[3];         ///< Neuron counts of the last checkpoint.
+    uint16_t epochCount;         ///< Epoch count of the last checkpoint.
+    uint16_t blockCount;         ///< Number of blocks in the last checkpoint.
+    uint16_t* slots;             ///< Slot of every block in the last checkpoint.
+    uint16_t lastWrites;         ///< Number of slots written by the last checkpoint.
+    uint16_t* pending;           ///< Slot of every block of the checkpoint being written.
+    uint16_t pendingCount;       ///< Number of blocks of the checkpoint being written.
+
+    /**
+     * @brief Compute the CRC-16/CCITT of the given bytes.
+     * @param crc Initial CRC value.
+     * @param data Pointer to the bytes.
+     * @param length Number of bytes.
+     * @return The updated CRC value.
+     */
+    static uint16_t crc16(uint16_t crc, const uint8_t* data, uint8_t length);
+
+    /**
+     * @brief Get the size of a weight or bias array of a topology.
+     * @param topology Input, hidden and output neuron counts.
+     * @param index Index of the array, counted from N2CMU_PARAM_HIDDEN_WEIGHTS.
+     * @return Number of elements in the array.
+     */
+    static uint16_t parameterSize(const uint8_t* topology, uint8_t index);
+
+    /**
+     * @brief Get the number of parameters of a topology.
+     * @param topology Input, hidden and output neuron counts.
+     * @return Number of weights and biases.
+     */
+    static uint32_t modelSize(const uint8_t* topology);
+
+    /**
+     * @brief Get the number of blocks of a topology.
+     * @param topology Input, hidden and output neuron counts.
+     * @return Number of blocks the weights and biases are split into.
+     */
+    static uint32_t modelBlocks(const uint8_t* topology);
+
+    /**
+     * @brief Check whether the region holds two checkpoints of a model.
+     * @param blocks Number of blocks of the model.
+     * @return True if the model can be checkpointed, false otherwise.
+     */
+    bool fits(uint32_t blocks) const;
+
+    /**
+     * @brief Read and verify a slot.
+     * @param slot Index of the slot.
+     * @param block Pointer to store the block number.
+     * @param sequence Pointer to store the sequence number.
+     * @param payload Pointer to store the payload, may be NULL.
+     * @return True if the slot holds a valid copy, false otherwise.
+     */
+    bool readSlot(
+        uint16_t slot,
+        uint16_t* block,
+        uint32_t* sequence,
+        uint8_t* payload
+    );
+
+    /**
+     * @brief Write a block to the next free slot.
+     * @param block Block number, or N2CMU_CHECKPOINT_COMMIT.
+     * @param payload Pointer to the payload.
+     * @return Index of the slot written.
+     */
+    uint16_t writeSlot(uint16_t block, const uint8_t* payload);
+
+    /**
+     * @brief Invalidate a slot by corrupting its CRC.
+     * @param slot Index of the slot.
+     */
+    void eraseSlot(uint16_t slot);
+
+    /**
+     * @brief Check whether a slot belongs to the last checkpoint.
+     *
+     * The slots written so far for the checkpoint being taken
+     * are protected as well.
+     *
+     * @param slot Index of the slot.
+     * @return True if the slot must not be overwritten, false otherwise.
+     */
+    bool isLive(uint16_t slot);
+
+    /**
+     * @brief Compare a payload with the one stored in a slot.
+     * @param slot Index of the slot.
+     * @param payload Pointer to the payload.
+     * @return True if the slot holds the same payload, false otherwise.
+     */
+    bool matchesSlot(uint16_t slot, const uint8_t* payload);
+
+    /**
+     * @brief Write one byte of the checkpoint region.
+     * @param offset Offset of the byte in the region.
+     * @param value The byte to write.
+     */
+    void writeByte(uint16_t offset, uint8_t value);
+
+    /**
+     * @brief Load the last committed checkpoint into the coprocessor.
+     * @param slot Slot of the commit record.
+     * @param commit Sequence number of the commit record.
+     * @return True if the checkpoint was restored, false otherwise.
+     */
+    bool restore(uint16_t slot, uint32_t commit);
+
+    /**
+     * @brief Collect a value received from the coprocessor into its block.
+     *
+     * Every completed block is compared with its copy and written
+     * to a new slot if it changed.
+     *
+     * @param index Index of the value in the parameter array.
+     * @param value Pointer to the value.
+     * @param context Pointer to the N2CheckpointStream of the checkpoint.
+     */
+    static void saveValue(uint16_t index, float* value, void* context);
+
+    /**
+     * @brief Supply a value to send to the coprocessor from its block.
+     * @param index Index of the value in the parameter array.
+     * @param value Pointer to store the value.
+     * @param context Pointer to the N2CheckpointStream of the checkpoint.
+     */
+    static void restoreValue(uint16_t index, float* value, void* context);
+
+public:
+    /**
+     * @brief Constructor for N2Checkpoint class.
+     *
+     * @param coprocessor Coprocessor whose model is checkpointed.
+     * @param address First EEPROM address of the checkpoint region.
+     * @param length Size of the checkpoint region in bytes.
+     */
+    N2Checkpoint(
+        N2Coprocessor& coprocessor,
+        uint16_t address = 0,
+        uint16_t length = N2CMU_CHECKPOINT_SIZE
+    );
+
+    /**
+     * @brief Destructor for N2Checkpoint class.
+     */
+    ~N2Checkpoint();
+
+    /**
+     * @brief Scan the checkpoint region and restore the latest checkpoint.
+     *
+     * This function must be called after N2Coprocessor::begin().
+     * It finds the latest complete checkpoint, discards blocks left
+     * behind by an interrupted one, and loads the topology, epoch
+     * count, weights and biases into the coprocessor.
+     *
+     * The region is rejected if it cannot hold two checkpoints of the
+     * stored model or, without one, of the model on the coprocessor.
+     * Then nothing is restored, getSlotCount() returns 0 and save()
+     * fails until begin() is called again.
+     *
+     * @return True if a checkpoint was restored, false if there was none.
+     */
+    bool begin();
+
+    /**
+     * @brief Take a checkpoint of the current model.
+     *
+     * Only the blocks which differ from the last checkpoint are
+     * written, followed by a commit record. No checkpoint is taken
+     * during a model update, whose staged parameters are not active,
+     * or if the region cannot hold two checkpoints of the model.
+     *
+     * @return True if the checkpoint was committed, false otherwise.
+     */
+    bool save();
+
+    /**
+     * @brief Invalidate all checkpoints in the region.
+     */
+    void clear();
+
+    /**
+     * @brief Get the region size needed to checkpoint a topology.
+     * @param inputCount Number of input neurons.
+     * @param hiddenCount Number of hidden neurons.
+     * @param outputCount Number of output neurons.
+     * @return Size of the region in bytes.
+     */
+    static uint32_t getRequiredSize(
+        uint8_t inputCount,
+        uint8_t hiddenCount,
+        uint8_t outputCount
+    );
+
+    /**
+     * @brief Get the number of slots in the checkpoint region.
+     * @return Number of slots.
+     */
+    uint16_t getSlotCount() const {
+        return this->slotCount;
+    }
+
+    /**
+     * @brief Get the number of slots written by the last checkpoint.
+     * @return Number of slots, including the commit record.
+     */
+    uint16_t getLastWriteCount() const {
+        return this->lastWrites;
+    }
+};
+
+#endif
+#endif
@@ -69,6 +69,14 @@ typedef enum N2CMUCommands {
     N2CMU_GET_HIDDEN_GRAD = 0x1b,     ///< Command constant for getting hidden neuron gradients.
     N2CMU_GET_OUTPUT_GRAD = 0x1c,     ///< Command constant for getting output neuron gradients.
     N2CMU_GET_EPOCH_COUNT = 0x1d,     ///< Command constant for getting the epoch count of training.
+
+    N2CMU_NET_TRAIN_OPTIMIZED = 0x1e, ///< Command constant for training a neural network with an optimizer configuration.
+    N2CMU_NET_EVALUATE = 0x1f,        ///< Command constant for evaluating a neural network over a data set.
+    N2CMU_GET_PERF = 0x20,            ///< Command constant for getting the device performance counters.
+    N2CMU_NET_SWEEP = 0x21,           ///< Command constant for running a hyperparameter sweep.
+    N2CMU_SET_PROGRESS_INTERVAL = 0x22, ///< Command constant for setting the training progress interval.
+    N2CMU_MODEL_STAGE = 0x23,         ///< Command constant for opening or discarding the model staging slot.
+    N2CMU_MODEL_COMMIT = 0x24,        ///< Command constant for swapping the staged model in.
 } N2CMUCommands;
 
 #endif
\ No newline at end of file
@@ -0,0 +1,234 @@
+/*
+ * This file is part of the N2CMU Arduino library (https://github.com/nthnn/n2cmu-arduino).
+ * Copyright (c) 2024 Nathanne Isip.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARDUINO
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "n2cmu_posix.h"
+
+N2PosixSerial::~N2PosixSerial() {
+    this->end();
+}
+
+bool N2PosixSerial::applyBaudRate() {
+    speed_t speed;
+
+    switch(this->baud) {
+        case 9600: speed = B9600; break;
+        case 19200: speed = B19200; break;
+        case 38400: speed = B38400; break;
+        case 57600: speed = B57600; break;
+        case 115200: speed = B115200; break;
+        case 230400: speed = B230400; break;
+        default:
+            return n2cmuSetCustomBaudRate(this->fd, this->baud);
+    }
+
+    struct termios tty;
+    if(tcgetattr(this->fd, &tty) != 0)
+        return false;
+
+    cfsetispeed(&tty, speed);
+    cfsetospeed(&tty, speed);
+
+    return tcsetattr(this->fd, TCSANOW, &tty) == 0;
+}
+
+bool N2PosixSerial::begin() {
+    this->end();
+
+    this->fd = open(this->device, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if(this->fd < 0)
+        return false;
+
+    struct termios tty;
+    if(tcgetattr(this->fd, &tty) != 0) {
+        this->end();
+        return false;
+    }
+
+    cfmakeraw(&tty);
+    tty.c_cflag |= CLOCAL | CREAD;
+    tty.c_cflag &= ~CSTOPB;
+    tty.c_cc[VMIN] = 0;
+    tty.c_cc[VTIME] = 0;
+
+    if(tcsetattr(this->fd, TCSANOW, &tty) != 0 ||
+        !this->applyBaudRate()) {
+        this->end();
+        return false;
+    }
+
+    tcflush(this->fd, TCIOFLUSH);
+    return true;
+}
+
+void N2PosixSerial::end() {
+    if(this->fd >= 0)
+        close(this->fd);
+
+    this->fd = -1;
+    this->head = this->tail = 0;
+}
+
+int N2PosixSerial::available() {
+    if(this->fd < 0)
+        return this->tail - this->head;
+
+    if(this->head == this->tail)
+        this->head = this->tail = 0;
+    else if(this->tail == N2CMU_POSIX_BUFFER_SIZE && this->head > 0) {
+        memmove(
+            this->buffer,
+            this->buffer + this->head,
+            this->tail - this->head
+        );
+
+        this->tail -= this->head;
+        this->head = 0;
+    }
+
+    if(this->head == this->tail) {
+        struct pollfd pfd;
+        pfd.fd = this->fd;
+        pfd.events = POLLIN;
+
+        if(poll(&pfd, 1, 1) <= 0 || !(pfd.revents & POLLIN))
+            return 0;
+    }
+
+    if(this->tail < N2CMU_POSIX_BUFFER_SIZE) {
+        ssize_t count = ::read(
+            this->fd,
+            this->buffer + this->tail,
+            N2CMU_POSIX_BUFFER_SIZE - this->tail
+        );
+
+        if(count > 0)
+            this->tail += (uint8_t) count;
+    }
+
+    return this->tail - this->head;
+}
+
+int N2PosixSerial::read() {
+    if(this->available() == 0)
+        return -1;
+
+    return this->buffer[this->head++];
+}
+
+size_t N2PosixSerial::write(uint8_t data) {
+    while(this->fd >= 0) {
+        ssize_t count = ::write(this->fd, &data, 1);
+        if(count == 1)
+            return 1;
+
+        if(count < 0 && errno != EAGAIN && errno != EINTR)
+            break;
+
+        struct pollfd pfd;
+        pfd.fd = this->fd;
+        pfd.events = POLLOUT;
+        poll(&pfd, 1, 1);
+    }
+
+    return 0;
+}
+
+N2PosixEEPROM EEPROM;
+
+N2PosixEEPROM::~N2PosixEEPROM() {
+    free(this->data);
+}
+
+bool N2PosixEEPROM::begin(size_t size) {
+    free(this->data);
+
+    this->data = (uint8_t*) malloc(size);
+    this->size = this->data == NULL ? 0 : size;
+    if(this->data == NULL)
+        return false;
+
+    memset(this->data, 0xff, size);
+
+    FILE *file = fopen(this->path, "rb");
+    if(file != NULL) {
+        size_t count = fread(this->data, 1, size, file);
+        (void) count;
+
+        fclose(file);
+    }
+
+    return true;
+}
+
+uint8_t N2PosixEEPROM::read(int address) {
+    if(address < 0 || (size_t) address >= this->size)
+        return 0xff;
+
+    return this->data[address];
+}
+
+void N2PosixEEPROM::write(int address, uint8_t value) {
+    if(address >= 0 && (size_t) address < this->size)
+        this->data[address] = value;
+}
+
+bool N2PosixEEPROM::commit() {
+    FILE *file = fopen(this->path, "wb");
+    if(file == NULL)
+        return false;
+
+    bool result = fwrite(this->data, 1, this->size, file) == this->size;
+    return fclose(file) == 0 && result;
+}
+
+static uint64_t n2cmuMonotonicMicros() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * 1000000ULL +
+        (uint64_t) now.tv_nsec / 1000ULL;
+}
+
+void delayMicroseconds(unsigned int us) {
+    struct timespec duration;
+    duration.tv_sec = us / 1000000;
+    duration.tv_nsec = (long) (us % 1000000) * 1000L;
+
+    while(nanosleep(&duration, &duration) != 0 && errno == EINTR);
+}
+
+unsigned long millis() {
+    return (unsigned long) (n2cmuMonotonicMicros() / 1000ULL);
+}
+
+unsigned long micros() {
+    return (unsigned long) n2cmuMonotonicMicros();
+}
+
+#endif
@@ -0,0 +1,229 @@
+/*
+ * This file is part of the N2CMU Arduino library (https://github.com/nthnn/n2cmu-arduino).
+ * Copyright (c) 2024 Nathanne Isip.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file n2cmu_posix.h
+ * @brief Header file for the POSIX serial port transport of N2CMU.
+ * @author [Nathanne Isip](https://github.com/nthnn)
+ *
+ * This header file defines the N2PosixSerial class, which drives
+ * an N2CMU device from a Linux host through a termios serial port
+ * such as a USB-UART adapter, a file-backed stand-in for the Arduino
+ * EEPROM, and the few Arduino timing functions the library relies
+ * on. It is only used on non-Arduino builds.
+ */
+#ifndef N2CMU_POSIX_H
+#define N2CMU_POSIX_H
+
+#ifndef ARDUINO
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define N2CMU_DEVICE_PATH "/dev/ttyUSB0" ///< Default serial device of the N2CMU on Linux hosts.
+#define N2CMU_POSIX_BUFFER_SIZE 64       ///< Size of the receive buffer of N2PosixSerial.
+#define N2CMU_EEPROM_PATH "n2cmu.eeprom" ///< Backing file of the emulated EEPROM on Linux hosts.
+
+#define PROGMEM                                                 ///< Flash placement, a no-op on POSIX hosts.
+#define pgm_read_byte(address) (*(const uint8_t*) (address))   ///< Read a byte placed with PROGMEM.
+#define pgm_read_float(address) (*(const float*) (address))    ///< Read a float placed with PROGMEM.
+#define memcpy_P(dest, src, length) memcpy(dest, src, length)   ///< Copy data placed with PROGMEM.
+
+/**
+ * @class N2PosixSerial
+ * @brief Serial port transport for N2CMU on POSIX hosts.
+ *
+ * The N2PosixSerial class offers the subset of the Arduino serial
+ * interface used by N2Coprocessor on top of a raw termios port.
+ * The port is opened non-blocking and incoming bytes are collected
+ * with poll() into a small receive buffer.
+ */
+class N2PosixSerial {
+private:
+    const char *device;                            ///< Path of the serial device.
+    long baud;                                     ///< Baud rate of the serial device.
+    int fd;                                        ///< File descriptor of the open port, -1 if closed.
+    uint8_t buffer[N2CMU_POSIX_BUFFER_SIZE];       ///< Receive buffer.
+    uint8_t head;                                  ///< Index of the next byte to read from the buffer.
+    uint8_t tail;                                  ///< Index past the last received byte in the buffer.
+
+    /**
+     * @brief Apply the configured baud rate to the open port.
+     * @return True if the baud rate was applied, false otherwise.
+     */
+    bool applyBaudRate();
+
+public:
+    /**
+     * @brief Constructor for N2PosixSerial class.
+     * @param device Path of the serial device.
+     * @param baud Baud rate of the serial device.
+     */
+    N2PosixSerial(const char *device, long baud):
+        device(device), baud(baud), fd(-1), head(0), tail(0) { }
+
+    /**
+     * @brief Destructor, closes the port.
+     */
+    ~N2PosixSerial();
+
+    /**
+     * @brief Open the port in raw mode.
+     * @return True if the port was opened and configured, false otherwise.
+     */
+    bool begin();
+
+    /**
+     * @brief Close the port.
+     */
+    void end();
+
+    /**
+     * @brief Get the number of received bytes ready to be read.
+     *
+     * Reads any newly arrived data into the receive buffer.
+     * When the buffer is empty, polls the port for at most
+     * one millisecond.
+     *
+     * @return Number of bytes available.
+     */
+    int available();
+
+    /**
+     * @brief Read one received byte.
+     * @return The byte read, or -1 if none is available.
+     */
+    int read();
+
+    /**
+     * @brief Write one byte to the port.
+     * @param data The byte to write.
+     * @return Number of bytes written.
+     */
+    size_t write(uint8_t data);
+
+    /**
+     * @brief Check whether the port is open.
+     * @return True if the port is open, false otherwise.
+     */
+    operator bool() const {
+        return this->fd >= 0;
+    }
+};
+
+/**
+ * @class N2PosixEEPROM
+ * @brief File-backed EEPROM for POSIX hosts.
+ *
+ * The N2PosixEEPROM class mirrors the buffered EEPROM interface of
+ * the ESP32 and ESP8266 cores. The contents are loaded from the
+ * backing file by begin(), changed in memory by write(), and saved
+ * back by commit(). Bytes never written read as 0xFF, like erased
+ * EEPROM cells.
+ */
+class N2PosixEEPROM {
+private:
+    const char *path;   ///< Path of the backing file.
+    uint8_t *data;      ///< In-memory contents.
+    size_t size;        ///< Size of the contents in bytes.
+
+public:
+    /**
+     * @brief Constructor for N2PosixEEPROM class.
+     * @param path Path of the backing file.
+     */
+    N2PosixEEPROM(const char *path = N2CMU_EEPROM_PATH):
+        path(path), data(NULL), size(0) { }
+
+    /**
+     * @brief Destructor, releases the in-memory contents.
+     */
+    ~N2PosixEEPROM();
+
+    /**
+     * @brief Load the given number of bytes from the backing file.
+     * @param size Size of the EEPROM in bytes.
+     * @return True if the contents were allocated, false otherwise.
+     */
+    bool begin(size_t size);
+
+    /**
+     * @brief Read one byte.
+     * @param address Address of the byte.
+     * @return The byte read, or 0xFF past the end.
+     */
+    uint8_t read(int address);
+
+    /**
+     * @brief Write one byte in memory.
+     * @param address Address of the byte.
+     * @param value The byte to write.
+     */
+    void write(int address, uint8_t value);
+
+    /**
+     * @brief Save the contents to the backing file.
+     * @return True if the contents were saved, false otherwise.
+     */
+    bool commit();
+
+    /**
+     * @brief Get the size of the EEPROM.
+     * @return Size of the EEPROM in bytes.
+     */
+    uint16_t length() const {
+        return (uint16_t) this->size;
+    }
+};
+
+extern N2PosixEEPROM EEPROM; ///< EEPROM of the host, backed by N2CMU_EEPROM_PATH.
+
+/**
+ * @brief Pause for the given number of microseconds.
+ * @param us Number of microseconds to pause.
+ */
+void delayMicroseconds(unsigned int us);
+
+/**
+ * @brief Get the number of milliseconds from the monotonic clock.
+ * @return Number of milliseconds.
+ */
+unsigned long millis();
+
+/**
+ * @brief Get the number of microseconds from the monotonic clock.
+ * @return Number of microseconds.
+ */
+unsigned long micros();
+
+/**
+ * @brief Set a baud rate which has no termios speed constant.
+ *
+ * This is used for rates such as the 31250 baud of the N2CMU,
+ * which Linux supports through the termios2 interface. It is
+ * kept in its own translation unit since the kernel termios
+ * headers clash with the libc ones.
+ *
+ * @param fd File descriptor of the open port.
+ * @param baud Baud rate to set.
+ * @return True if the baud rate was set, false otherwise.
+ */
+bool n2cmuSetCustomBaudRate(int fd, long baud);
+
+#endif
+#endif
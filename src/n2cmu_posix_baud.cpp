@@ -0,0 +1,45 @@
+/*
+ * This file is part of the N2CMU Arduino library (https://github.com/nthnn/n2cmu-arduino).
+ * Copyright (c) 2024 Nathanne Isip.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ARDUINO
+
+#ifdef __linux__
+#include <asm/termbits.h>
+#include <sys/ioctl.h>
+#endif
+
+bool n2cmuSetCustomBaudRate(int fd, long baud) {
+#ifdef __linux__
+    struct termios2 tty;
+    if(ioctl(fd, TCGETS2, &tty) != 0)
+        return false;
+
+    tty.c_cflag &= ~CBAUD;
+    tty.c_cflag |= BOTHER;
+    tty.c_ispeed = (speed_t) baud;
+    tty.c_ospeed = (speed_t) baud;
+
+    return ioctl(fd, TCSETS2, &tty) == 0;
+#else
+    (void) fd;
+    (void) baud;
+
+    return false;
+#endif
+}
+
+#endif
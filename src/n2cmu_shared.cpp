@@ -0,0 +1,155 @@
+/*
+ * This file is part of the N2CMU Arduino library (https://github.com/nthnn/n2cmu-arduino).
+ * Copyright (c) 2024 Nathanne Isip.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "n2cmu_shared.h"
+
+#ifdef N2CMU_HAS_THREADS
+
+N2SharedCoprocessor::~N2SharedCoprocessor() {
+    this->stop();
+}
+
+bool N2SharedCoprocessor::start() {
+    std::lock_guard<std::mutex> guard(this->lock);
+    if(this->running || this->owner.joinable())
+        return false;
+
+    this->running = true;
+    this->owner = std::thread(&N2SharedCoprocessor::run, this);
+
+    return true;
+}
+
+void N2SharedCoprocessor::stop() {
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->running = false;
+    }
+
+    this->notEmpty.notify_all();
+    this->notFull.notify_all();
+
+    if(this->owner.joinable())
+        this->owner.join();
+}
+
+bool N2SharedCoprocessor::enqueue(Request& request) {
+    std::unique_lock<std::mutex> guard(this->lock);
+    this->notFull.wait(guard, [this] {
+        return !this->running ||
+            this->queue.size() < this->capacity;
+    });
+
+    if(!this->running)
+        return false;
+
+    this->queue.push_back(std::move(request));
+    guard.unlock();
+
+    this->notEmpty.notify_one();
+    return true;
+}
+
+void N2SharedCoprocessor::complete(Request& request, bool result) {
+    if(request.callback)
+        request.callback(result);
+    else request.promise.set_value(result);
+}
+
+void N2SharedCoprocessor::run() {
+    while(true) {
+        std::deque<Request> batch;
+
+        {
+            std::unique_lock<std::mutex> guard(this->lock);
+            this->notEmpty.wait(guard, [this] {
+                return !this->running || !this->queue.empty();
+            });
+
+            if(this->queue.empty())
+                break;
+            batch.swap(this->queue);
+        }
+        this->notFull.notify_all();
+
+        uint8_t inputCount = 0, outputCount = 0;
+
+        for(Request& request : batch) {
+            bool result;
+
+            if(request.type == N2CMU_REQUEST_INFER)
+                result = this->coprocessor.runInference(
+                    request.input,
+                    request.output,
+                    inputCount,
+                    outputCount
+                );
+            else {
+                result = request.task(this->coprocessor);
+                outputCount = 0;
+            }
+
+            complete(request, result);
+        }
+    }
+}
+
+std::future<bool> N2SharedCoprocessor::infer(float* input, float* output) {
+    Request request;
+    request.type = N2CMU_REQUEST_INFER;
+    request.input = input;
+    request.output = output;
+
+    std::future<bool> result = request.promise.get_future();
+    if(!this->enqueue(request))
+        request.promise.set_value(false);
+
+    return result;
+}
+
+bool N2SharedCoprocessor::infer(float* input, float* output, Callback callback) {
+    Request request;
+    request.type = N2CMU_REQUEST_INFER;
+    request.input = input;
+    request.output = output;
+    request.callback = callback;
+
+    return this->enqueue(request);
+}
+
+std::future<bool> N2SharedCoprocessor::submit(Task task) {
+    Request request;
+    request.type = N2CMU_REQUEST_TASK;
+    request.task = task;
+
+    std::future<bool> result = request.promise.get_future();
+    if(!this->enqueue(request))
+        request.promise.set_value(false);
+
+    return result;
+}
+
+bool N2SharedCoprocessor::submit(Task task, Callback callback) {
+    Request request;
+    request.type = N2CMU_REQUEST_TASK;
+    request.task = task;
+    request.callback = callback;
+
+    return this->enqueue(request);
+}
+
+#endif
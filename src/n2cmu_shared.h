@@ -0,0 +1,212 @@
+/*
+ * This file is part of the N2CMU Arduino library (https://github.com/nthnn/n2cmu-arduino).
+ * Copyright (c) 2024 Nathanne Isip.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * @file n2cmu_shared.h
+ * @brief Header file for sharing one N2CMU device between several tasks or threads.
+ * @author [Nathanne Isip](https://github.com/nthnn)
+ *
+ * This header file defines the N2SharedCoprocessor class, a
+ * concurrency-safe front end for N2Coprocessor. Requests from any
+ * number of tasks are placed in a bounded queue and executed by a
+ * single owner thread, which is the only one touching the serial
+ * link. It is available on hosts with C++11 threads, such as the
+ * ESP32 under FreeRTOS and Linux.
+ */
+#ifndef N2CMU_SHARED_H
+#define N2CMU_SHARED_H
+
+#if defined(ESP32) || !defined(ARDUINO)
+#define N2CMU_HAS_THREADS ///< Defined when N2SharedCoprocessor is available.
+#endif
+
+#ifdef N2CMU_HAS_THREADS
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+
+#include "n2cmu.h"
+
+#define N2CMU_QUEUE_CAPACITY 16 ///< Default number of pending requests in the shared queue.
+
+/**
+ * @class N2SharedCoprocessor
+ * @brief Thread-safe request queue in front of an N2Coprocessor.
+ *
+ * The N2SharedCoprocessor class owns a worker thread that drives
+ * the serial link of an N2Coprocessor. Other tasks submit requests
+ * and get either a future or a callback upon completion. Requests
+ * which arrive while the link is busy are drained together, and
+ * consecutive inferences in such a batch share one topology query,
+ * so they go out as back-to-back transfers. Inferences take the same
+ * path as N2Coprocessor::infer(), with its inference cache, timeouts
+ * and recovery.
+ */
+class N2SharedCoprocessor {
+public:
+    /**
+     * @brief Generic request executed on the owner thread.
+     *
+     * The task receives exclusive access to the coprocessor
+     * for its whole duration and returns its success status.
+     */
+    typedef std::function<bool(N2Coprocessor&)> Task;
+
+    /**
+     * @brief Completion callback, invoked on the owner thread.
+     */
+    typedef std::function<void(bool)> Callback;
+
+private:
+    /**
+     * @brief Kind of a queued request.
+     */
+    enum RequestType {
+        N2CMU_REQUEST_INFER, ///< Inference request.
+        N2CMU_REQUEST_TASK   ///< Generic task request.
+    };
+
+    /**
+     * @brief A single queued request.
+     */
+    struct Request {
+        RequestType type;            ///< Kind of request.
+        float* input;                ///< Input vector of an inference request.
+        float* output;               ///< Output vector of an inference request.
+        Task task;                   ///< Task of a generic request.
+        Callback callback;           ///< Completion callback, if any.
+        std::promise<bool> promise;  ///< Completion promise, if no callback is set.
+    };
+
+    N2Coprocessor& coprocessor;          ///< Coprocessor driven by the owner thread.
+    size_t capacity;                     ///< Maximum number of pending requests.
+    std::deque<Request> queue;           ///< Pending requests.
+    std::mutex lock;                     ///< Guards the queue and the running state.
+    std::condition_variable notEmpty;    ///< Signalled when a request is queued.
+    std::condition_variable notFull;     ///< Signalled when the queue is drained.
+    std::thread owner;                   ///< Thread driving the serial link.
+    bool running;                        ///< True while requests are accepted.
+
+    /**
+     * @brief Queue a request, blocking while the queue is full.
+     * @param request The request to queue.
+     * @return True if the request was queued, false if the front end is stopped.
+     */
+    bool enqueue(Request& request);
+
+    /**
+     * @brief Main loop of the owner thread.
+     */
+    void run();
+
+    /**
+     * @brief Complete a request with the given result.
+     * @param request The request to complete.
+     * @param result The result of the request.
+     */
+    static void complete(Request& request, bool result);
+
+public:
+    /**
+     * @brief Constructor for N2SharedCoprocessor class.
+     *
+     * The coprocessor must already be initialized with
+     * N2Coprocessor::begin() and must not be used directly
+     * while the shared front end is running.
+     *
+     * @param coprocessor The coprocessor to share.
+     * @param capacity Maximum number of pending requests.
+     */
+    N2SharedCoprocessor(
+        N2Coprocessor& coprocessor,
+        size_t capacity = N2CMU_QUEUE_CAPACITY
+    ): coprocessor(coprocessor), capacity(capacity), running(false) { }
+
+    /**
+     * @brief Destructor, stops the owner thread.
+     */
+    ~N2SharedCoprocessor();
+
+    /**
+     * @brief Start the owner thread.
+     *
+     * On the ESP32 the thread is created with the pthread
+     * defaults, which can be changed with esp_pthread_set_cfg()
+     * before calling this function.
+     *
+     * @return True if the owner thread was started, false if it was already running.
+     */
+    bool start();
+
+    /**
+     * @brief Stop the owner thread.
+     *
+     * Requests already in the queue are still executed.
+     * Requests submitted afterwards complete immediately
+     * with a false result.
+     */
+    void stop();
+
+    /**
+     * @brief Queue an inference and get a future for its result.
+     *
+     * Both buffers must stay valid until the future is ready.
+     *
+     * @param input Pointer to the input data array.
+     * @param output Pointer to store the output data array.
+     * @return Future which becomes true if inference was successful.
+     */
+    std::future<bool> infer(float* input, float* output);
+
+    /**
+     * @brief Queue an inference with a completion callback.
+     *
+     * Both buffers must stay valid until the callback is invoked.
+     *
+     * @param input Pointer to the input data array.
+     * @param output Pointer to store the output data array.
+     * @param callback Callback invoked with the result on the owner thread.
+     * @return True if the request was queued, false otherwise.
+     */
+    bool infer(float* input, float* output, Callback callback);
+
+    /**
+     * @brief Queue a generic task and get a future for its result.
+     *
+     * This is how training, parameter access and any other
+     * N2Coprocessor operation is run on a shared coprocessor.
+     *
+     * @param task The task to execute on the owner thread.
+     * @return Future which becomes the result of the task.
+     */
+    std::future<bool> submit(Task task);
+
+    /**
+     * @brief Queue a generic task with a completion callback.
+     * @param task The task to execute on the owner thread.
+     * @param callback Callback invoked with the result on the owner thread.
+     * @return True if the request was queued, false otherwise.
+     */
+    bool submit(Task task, Callback callback);
+};
+
+#endif
+#endif